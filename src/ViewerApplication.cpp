@@ -1,7 +1,12 @@
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <numeric>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -12,10 +17,15 @@
 #include "utils/bbox.hpp"
 #include "utils/cameras.hpp"
 #include "utils/cube.hpp"
+#include "utils/fixedTimestep.hpp"
+#include "utils/frustum.hpp"
+#include "utils/geometryRegistry.hpp"
+#include "utils/glStateCache.hpp"
 #include "utils/line.hpp"
+#include "utils/programCache.hpp"
 #include "utils/quad.hpp"
+#include "utils/shaderPermutations.hpp"
 #include "utils/skybox.hpp"
-#include "utils/uniformHandler.hpp"
 
 #include <stb_image.h>
 #include <stb_image_write.h>
@@ -90,27 +100,57 @@ void process_continuous_input(GLFWwindow *window)
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
     glfwSetWindowShouldClose(window, true);
   }
-  player.update();
 }
 
 int ViewerApplication::run()
 {
-  // Loader shaders
-  auto glslProgram = compileProgram({m_ShadersRootPath / m_vertexShader,
-      m_ShadersRootPath / m_fragmentShader});
-
-  // tinygltf::Model model;
-  // loadGltfFile(model);
-
-  std::cout << "Model imported : " << m_gltfFilePath << std::endl;
-
-  // glm::vec3 bboxMin, bboxMax;
-  // computeSceneBounds(model, bboxMin, bboxMax);
-
-  GLuint tangentVBO;
-  glGenBuffers(1, &tangentVBO);
-
-  // ComputeTangents(model);
+  // Linked programs, cooked scenes and decoded textures are cached next to
+  // the executable
+  const auto cacheDirectory = m_AppPath.parent_path() / "cache";
+  ProgramCache programCache{cacheDirectory / "programs"};
+
+  // Loader shaders, specialized per draw by the defines below. The variant
+  // without defines draws until the other ones are compiled.
+  enum ForwardVariant : uint32_t
+  {
+    NoInstances = 1,
+    HasNormals = 2,
+    NoNormals = 4,
+    NormalMap = 8
+  };
+  ShaderPermutations forwardPrograms{programCache,
+      {m_ShadersRootPath / m_vertexShader,
+          m_ShadersRootPath / m_fragmentShader},
+      {"NO_INSTANCES", "HAS_NORMALS", "NO_NORMALS", "NORMAL_MAP"}};
+
+  // The scene is loaded by the workers and appears as it is uploaded
+  ThreadPool threadPool;
+  AsyncSceneLoader sceneLoader{threadPool, cacheDirectory};
+  // Exporters rarely order indices for the vertex cache, reordering them
+  // costs a little load time, once per file thanks to the cache. Same for
+  // the compression of the textures, which divides their memory by 4 to 8.
+  bool optimizeMeshes = true;
+  bool compressTextures = true;
+  const auto getLoadOptions = [&]() {
+    SceneLoadOptions options;
+    options.optimizeMeshes = optimizeMeshes;
+    if (compressTextures) {
+      options.textureFormats = getCompressedTextureFormats();
+    }
+    return options;
+  };
+  if (!m_gltfFilePath.empty()) {
+    sceneLoader.load(m_gltfFilePath, getLoadOptions());
+  }
+  const SceneData *scene = nullptr;
+  SceneObjects sceneObjects;
+  int uploadBudget = 16; // Megabytes per frame
+  uint32_t movedNodeCount = 0;
+  // Node edited in the Scene panel, flat index in sceneObjects.graph
+  int editedNode = 0;
+  bool spinEditedNode = false;
+  char scenePath[512] = {};
+  m_gltfFilePath.string().copy(scenePath, sizeof(scenePath) - 1);
 
   // Build projection matrix
   const auto diag = glm::vec3(1., 1., 1);
@@ -129,8 +169,6 @@ int ViewerApplication::run()
   //       Camera{glm::vec3(0, 1, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)});
   // }
 
-  // const auto textureObjects = createTextureObjects(model);
-
   // Gen default texture for object
   float white[] = {1., 1., 1., 1.};
   GLuint whiteTexture;
@@ -143,19 +181,45 @@ int ViewerApplication::run()
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
 
-  // const auto bufferObjects = createBufferObjects(model);
-  // bool tangentAccessor = false;
-
-  // std::vector<VaoRange> meshToVertexArrays;
-  // const auto vertexArrayObjects = createVertexArrayObjects(
-  //     model, bufferObjects, meshToVertexArrays, tangentAccessor);
+  // OpenGL state of the draws, set through glState which skips the calls
+  // that wouldn't change anything
+  GLStateCache glState;
 
-  // Setup OpenGL state for rendering
-  glEnable(GL_DEPTH_TEST);
-  glslProgram.use();
-
-  // getUniform(glslProgram);
-  const UniformHandler mainHandler{glslProgram};
+  // Material uniforms of each forward program, looked up once, -1 for the
+  // ones a program doesn't use
+  struct MaterialLocations
+  {
+    GLint baseColorTexture, baseColorFactor;
+    GLint normalTexture, normalScale;
+  };
+  std::unordered_map<GLuint, MaterialLocations> materialLocations;
+  const auto getMaterialLocations =
+      [&](const GLProgram &program) -> const MaterialLocations & {
+    auto it = materialLocations.find(program.glId());
+    if (it == end(materialLocations)) {
+      const auto id = program.glId();
+      it = materialLocations
+               .emplace(id,
+                   MaterialLocations{
+                       glGetUniformLocation(id, "uBaseColorTexture"),
+                       glGetUniformLocation(id, "uBaseColorFactor"),
+                       glGetUniformLocation(id, "uNormalTexture"),
+                       glGetUniformLocation(id, "uNormalScale")})
+               .first;
+    }
+    return it->second;
+  };
+  // Of the forward program in use
+  const MaterialLocations *locations = nullptr;
+  // Returns true if the program changed, its material uniforms are then unset
+  const auto useForwardProgram = [&](uint32_t variant) {
+    const auto &program = forwardPrograms.get(variant);
+    if (!glState.useProgram(program.glId())) {
+      return false;
+    }
+    locations = &getMaterialLocations(program);
+    return true;
+  };
 
   const auto pathToFaces = "assets/";
 
@@ -164,36 +228,195 @@ int ViewerApplication::run()
       "assets/skybox/bottom.jpg", "assets/skybox/front.jpg",
       "assets/skybox/back.jpg"};
 
-  QuadCustom quad(1, 1);
-  CubeCustom cube(2, 2, 2);
+  // Meshes of the built-in shapes, uploaded once per distinct shape
+  GeometryRegistry geometry;
+  QuadCustom quad(geometry, 1, 1);
+  CubeCustom cube(geometry, 2, 2, 2);
   cube.add({{0, 0, 0}, {0, 0, 2}, {13, -10, 0}, {4, 12, 0}, {4, 12, 0}}, bbox);
   // cube.add({{0, 0, 0}, {4, 5, 0}}, bbox);
   // cube.add({0, 0, 0}, bbox);
-  Skybox skybox(faces, m_ShadersRootPath);
+  Skybox skybox(geometry, faces, m_ShadersRootPath, programCache, threadPool,
+      getLoadOptions().textureFormats,
+      getTextureCacheDirectory(cacheDirectory));
 
   // quad.initObj(0, 1, 2);
   // cube.initObj(0, 1, 2);
 
+  Frustum frustum;
+  bool frustumCulling = true;
+
+  // Grid of points around the player tested against the boxes in one batch,
+  // like particles would be, shown in the Simulation panel
+  constexpr int probeSide = 16;
+  std::vector<glm::vec3> probePoints(probeSide * probeSide * probeSide);
+  std::unique_ptr<bool[]> probeResults(new bool[probePoints.size()]);
+
+  // Uniform variable for light
+  glm::vec3 lightDirection(1.f, 1.f, 1.f);
+  glm::vec3 lightIntensity(1.f, 1.f, 1.f);
+
+  // Matrices are uploaded once per frame, model matrices once per object
+  FrameUniformBuffer frameUniforms;
+  ObjectUniformBuffer objectUniforms;
+
+  const auto bindMaterial = [&](int32_t materialIdx) {
+    auto texture = whiteTexture;
+    glm::vec4 baseColorFactor(1.f);
+    if (materialIdx >= 0) {
+      const auto &material = scene->materials[materialIdx];
+      baseColorFactor = material.baseColorFactor;
+      // White until the texture is uploaded
+      if (sceneLoader.isTextureReady(material.baseColorTexture)) {
+        texture = sceneObjects.textureObjects[material.baseColorTexture];
+      }
+      // Only NORMAL_MAP variants read it, they are used once it is ready
+      if (locations->normalTexture >= 0 &&
+          sceneLoader.isTextureReady(material.normalTexture)) {
+        glState.bindTexture(1, GL_TEXTURE_2D,
+            sceneObjects.textureObjects[material.normalTexture]);
+        glUniform1i(locations->normalTexture, 1);
+        glUniform1f(locations->normalScale, material.normalScale);
+      }
+    }
+    if (locations->baseColorTexture >= 0) {
+      glState.bindTexture(0, GL_TEXTURE_2D, texture);
+      glUniform1i(locations->baseColorTexture, 0);
+    }
+    if (locations->baseColorFactor >= 0) {
+      glUniform4fv(
+          locations->baseColorFactor, 1, glm::value_ptr(baseColorFactor));
+    }
+  };
+
+  // Forward variant of a glTF primitive, from the attributes of its layout.
+  // With normalMap, normal mapping is added when the primitive can have it.
+  const auto getPrimitiveVariant = [&](const PrimitiveDraw &primitive,
+                                       bool normalMap) {
+    const auto attributes = sceneObjects.layoutAttributes[primitive.layout];
+    if (!(attributes & (1u << NormalLocation))) {
+      return NoInstances | NoNormals;
+    }
+    uint32_t variant = NoInstances | HasNormals;
+    if (normalMap && (attributes & (1u << TangentLocation)) &&
+        primitive.material >= 0 &&
+        scene->materials[primitive.material].normalTexture >= 0) {
+      variant |= NormalMap;
+    }
+    return variant;
+  };
+  // Normal mapping once the normal texture is resident
+  const auto getDrawVariant = [&](const PrimitiveDraw &primitive) {
+    const auto normalTexture =
+        primitive.material >= 0
+            ? scene->materials[primitive.material].normalTexture
+            : -1;
+    return getPrimitiveVariant(
+        primitive, sceneLoader.isTextureReady(normalTexture));
+  };
+
+  // Pixels covered on screen by the diagonal of bounds, seen from the
+  // camera, textures are assumed to cover their primitive once
+  const auto getScreenSize = [&](const kln::Aabb &bounds) {
+    const auto center = 0.5f * (bounds.min + bounds.max);
+    const auto radius = 0.5f * glm::length(bounds.max - bounds.min);
+    const auto distance = glm::length(center - player.camera.getPosition());
+    const auto pixelsPerUnit = projMatrix[1][1] * 0.5f * m_nWindowHeight;
+    return 2.f * radius * pixelsPerUnit /
+           std::max(distance - radius, 0.001f * maxDistance);
+  };
+
   const auto drawScene = [&]() {
+    // The GUI and the uploads changed the state since the last frame
+    glState.beginFrame();
+    glState.setDepthTest(true);
+    glState.setDepthMask(true); // For the clear
     glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     const auto viewMatrix = player.camera.getViewMatrix();
-    const auto modelMatrix = glm::mat4(1.0f);
-
-    skybox.draw(modelMatrix, viewMatrix, projMatrix); // always first
-
-    glslProgram.use();
-
-    cube.draw(viewMatrix, projMatrix, mainHandler);
+    frameUniforms.update(
+        viewMatrix, projMatrix, lightDirection, lightIntensity);
+    objectUniforms.upload();
+    frustum.update(projMatrix * viewMatrix);
+    const auto culling = frustumCulling ? &frustum : nullptr;
+
+    // always first, and never culled since it surrounds the camera
+    skybox.draw(glState);
+
+    useForwardProgram(
+        cube.isInstanced() ? HasNormals : NoInstances | HasNormals);
+    cube.draw(glState, objectUniforms, culling);
+
+    // glTF scene, culled in graph order, then drawn in an order where the
+    // vertex array and the material only change between groups of draws
+    auto &drawItems = sceneObjects.drawItems;
+    auto &textures = sceneLoader.getTextures();
+    for (size_t i = 0; i < drawItems.size(); ++i) {
+      const auto &item = drawItems[i];
+      sceneObjects.visibleItems[i] =
+          sceneLoader.isPrimitiveReady(item.primitive) &&
+          (!culling || culling->isVisible(item.bounds));
+      const auto &primitive = scene->primitives[item.primitive];
+      if (!sceneObjects.visibleItems[i] || primitive.material < 0) {
+        continue;
+      }
+      const auto &material = scene->materials[primitive.material];
+      const auto screenSize = getScreenSize(item.bounds);
+      // Only textures the program of the primitive samples
+      const auto &drawLocations =
+          getMaterialLocations(forwardPrograms.get(getDrawVariant(primitive)));
+      if (drawLocations.baseColorTexture >= 0) {
+        textures.request(material.baseColorTexture, screenSize);
+      }
+      // The normal texture waits for a variant that reads it
+      const auto variant = getPrimitiveVariant(primitive, true);
+      if ((variant & NormalMap) &&
+          getMaterialLocations(forwardPrograms.get(variant)).normalTexture >=
+              0) {
+        textures.request(material.normalTexture, screenSize);
+      }
+    }
+    uint32_t currentLayout = ~0u;
+    int32_t currentMaterial = -2;
+    for (const auto itemIdx : sceneObjects.drawOrder) {
+      if (!sceneObjects.visibleItems[itemIdx]) {
+        continue;
+      }
+      const auto &item = drawItems[itemIdx];
+      const auto &primitive = scene->primitives[item.primitive];
+      // The variant depends on the layout and the material
+      const auto layoutChanged = primitive.layout != currentLayout;
+      if (layoutChanged) {
+        currentLayout = primitive.layout;
+        glState.bindVertexArray(
+            sceneObjects.vertexArrayObjects[primitive.layout]);
+      }
+      if (layoutChanged || primitive.material != currentMaterial) {
+        if (useForwardProgram(getDrawVariant(primitive)) ||
+            primitive.material != currentMaterial) {
+          bindMaterial(primitive.material);
+          currentMaterial = primitive.material;
+        }
+      }
+      objectUniforms.bind(sceneObjects.nodeSlots[item.node]);
+      if (primitive.indexType) {
+        glDrawElementsBaseVertex(primitive.mode, GLsizei(primitive.count),
+            primitive.indexType, (const GLvoid *)primitive.indexOffset,
+            primitive.baseVertex);
+      } else {
+        glDrawArrays(
+            primitive.mode, primitive.baseVertex, GLsizei(primitive.count));
+      }
+    }
 
     // std::cout << bbox.globalCollidesWith(player.position);
 
-    player.drawLine(viewMatrix, projMatrix, mainHandler);
+    useForwardProgram(NoInstances | NoNormals);
+    player.drawLine(glState, objectUniforms, culling);
+    // Once per frame, so that later element buffer binds don't change the
+    // vertex arrays
+    glState.bindVertexArray(0);
   };
 
-  // Uniform variable for light
-  glm::vec3 lightDirection(1.f, 1.f, 1.f);
-  glm::vec3 lightIntensity(1.f, 1.f, 1.f);
   glm::vec3 color = {1.f, 1.f, 1.f};
   float theta = 1.f;
   float phi = 1.f;
@@ -202,6 +425,11 @@ int ViewerApplication::run()
   // Uniform variable for occlusion
   bool occlusionState = true;
 
+  // Physics runs at a fixed rate, the camera is interpolated between ticks
+  FixedTimestep simulation{60.f};
+  player.setDeltaTime(simulation.getDeltaTime());
+  auto lastFrameTime = glfwGetTime();
+
   // Loop until the user closes the window
   for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose();
       ++iterationCount) {
@@ -210,6 +438,37 @@ int ViewerApplication::run()
 
     process_continuous_input(m_GLFWHandle.window());
 
+    const auto frameDuration = seconds - lastFrameTime;
+    simulation.advance(frameDuration, [&]() { player.update(); });
+    lastFrameTime = seconds;
+    player.clearInput();
+    player.interpolateCamera(simulation.getAlpha());
+
+    if (sceneLoader.pollScene()) {
+      deleteSceneObjects(sceneObjects, objectUniforms);
+      const auto &loaded = *sceneLoader.getScene();
+      scene = &loaded.scene;
+      sceneObjects = createSceneObjects(loaded, objectUniforms);
+      editedNode = 0;
+      spinEditedNode = false;
+      sceneLoader.beginUpload(
+          sceneObjects.arenaBuffer, sceneObjects.textureObjects);
+      std::cout << "Model imported : " << loaded.path << std::endl;
+    }
+    sceneLoader.upload(size_t(uploadBudget) * 1024 * 1024);
+    forwardPrograms.poll();
+    if (scene) {
+      // Half a turn per second around the local Y axis, only the subtree of
+      // the node is updated
+      auto &graph = sceneObjects.graph;
+      if (spinEditedNode && uint32_t(editedNode) < graph.size()) {
+        graph.setLocalMatrix(editedNode,
+            glm::rotate(graph.getLocalMatrix(editedNode),
+                float(M_PI * frameDuration), glm::vec3(0, 1, 0)));
+      }
+      movedNodeCount = updateDrawItems(*scene, sceneObjects, objectUniforms);
+    }
+
     drawScene();
 
     // GUI code:
@@ -222,8 +481,88 @@ int ViewerApplication::run()
       if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("position : %.3f %.3f %.3f", player.camera.getPosition().x,
             player.camera.getPosition().y, player.camera.getPosition().z);
-        ImGui::End();
       }
+      if (ImGui::CollapsingHeader(
+              "Simulation", ImGuiTreeNodeFlags_DefaultOpen)) {
+        float tickRate = simulation.getTickRate();
+        if (ImGui::SliderFloat("tick rate (Hz)", &tickRate, 10.f, 240.f)) {
+          simulation.setTickRate(tickRate);
+          player.setDeltaTime(simulation.getDeltaTime());
+        }
+        ImGui::Text("collision kernels : %s per leaf, %s per batch",
+            kln::getSimdLevelName(
+                std::min(kln::SimdLevel::Sse41, kln::detectSimdLevel())),
+            kln::getSimdLevelName(kln::detectSimdLevel()));
+        const auto probeCenter = player.getPos();
+        for (size_t i = 0; i < probePoints.size(); ++i) {
+          const auto cell = glm::vec3(i % probeSide, i / probeSide % probeSide,
+              i / (probeSide * probeSide));
+          probePoints[i] = probeCenter + cell - glm::vec3(0.5f * probeSide);
+        }
+        bbox.globalCollidesWith(
+            probePoints.data(), probePoints.size(), probeResults.get());
+        ImGui::Text("probe points in boxes : %zu / %zu",
+            size_t(std::count(probeResults.get(),
+                probeResults.get() + probePoints.size(), true)),
+            probePoints.size());
+      }
+      if (ImGui::CollapsingHeader(
+              "Rendering", ImGuiTreeNodeFlags_DefaultOpen)) {
+        bool instanced = cube.isInstanced();
+        if (ImGui::Checkbox("instanced cubes", &instanced)) {
+          cube.setInstanced(instanced);
+        }
+        ImGui::Checkbox("frustum culling", &frustumCulling);
+        ImGui::Text("built-in meshes : %zu, shared : %u, %.1f KB",
+            geometry.getMeshCount(), geometry.getSharedCount(),
+            geometry.getSize() / 1024.f);
+        ImGui::Text("visible : %u, culled : %u", frustum.getVisibleCount(),
+            frustum.getCulledCount());
+        ImGui::Text("cached programs : %u, compiled : %u",
+            programCache.getHitCount(), programCache.getMissCount());
+        ImGui::Text("shader variants : %zu, compiling : %zu",
+            forwardPrograms.getReadyCount(), forwardPrograms.getPendingCount());
+        ImGui::Text("state calls : %u, skipped : %u", glState.getCallCount(),
+            glState.getSkippedCount());
+      }
+      if (ImGui::CollapsingHeader("Scene", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::InputText("glTF file", scenePath, sizeof(scenePath));
+        ImGui::Checkbox("optimize meshes", &optimizeMeshes);
+        ImGui::Checkbox("compress textures", &compressTextures);
+        if (ImGui::Button("Load")) {
+          sceneLoader.load(scenePath, getLoadOptions());
+        }
+        ImGui::SliderInt("upload budget (MB/frame)", &uploadBudget, 1, 128);
+        auto &textures = sceneLoader.getTextures();
+        int textureBudget = int(textures.getBudget() / (1024 * 1024));
+        if (ImGui::SliderInt(
+                "texture budget (MB)", &textureBudget, 16, 2048)) {
+          textures.setBudget(uint64_t(textureBudget) * 1024 * 1024);
+        }
+        ImGui::Text("textures : %.1f MB, released levels : %u",
+            textures.getResidentSize() / (1024.f * 1024.f),
+            textures.getReleasedLevelCount());
+        if (sceneLoader.isLoading()) {
+          ImGui::ProgressBar(sceneLoader.getProgress());
+        }
+        ImGui::Text("nodes : %u, moved : %u", sceneObjects.graph.size(),
+            movedNodeCount);
+        auto &graph = sceneObjects.graph;
+        if (graph.size()) {
+          ImGui::SliderInt("node", &editedNode, 0, int(graph.size()) - 1);
+          editedNode = std::clamp(editedNode, 0, int(graph.size()) - 1);
+          ImGui::Text("mesh : %d, subtree : %u nodes",
+              graph.getMesh(editedNode),
+              graph.getSubtreeEnd(editedNode) - editedNode);
+          auto localMatrix = graph.getLocalMatrix(editedNode);
+          if (ImGui::DragFloat3(
+                  "translation", glm::value_ptr(localMatrix[3]), 0.01f)) {
+            graph.setLocalMatrix(editedNode, localMatrix);
+          }
+          ImGui::Checkbox("spin", &spinEditedNode);
+        }
+      }
+      ImGui::End();
     }
 
     imguiRenderFrame();
@@ -240,20 +579,191 @@ int ViewerApplication::run()
     m_GLFWHandle.swapBuffers(); // Swap front and back buffers
   }
 
+  deleteSceneObjects(sceneObjects, objectUniforms);
+  geometry.release();
+
   // TODO clean up allocated GL data
 
   return 0;
 }
 
-ViewerApplication::ViewerApplication(
-    const fs::path &appPath, uint32_t width, uint32_t height) :
+GLuint ViewerApplication::createBufferObjects(const SceneData &scene)
+{
+  if (!scene.arenaSize) {
+    return 0;
+  }
+  GLuint arenaBuffer = 0;
+  glGenBuffers(1, &arenaBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, arenaBuffer);
+  // Only written by copies from the staging buffer, never mapped
+  glBufferStorage(GL_ARRAY_BUFFER, scene.arenaSize, nullptr, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return arenaBuffer;
+}
+
+std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
+    const SceneData &scene, GLuint arenaBuffer)
+{
+  std::vector<GLuint> vertexArrayObjects(scene.layouts.size(), 0);
+  if (vertexArrayObjects.empty()) {
+    return vertexArrayObjects;
+  }
+  glGenVertexArrays(GLsizei(vertexArrayObjects.size()),
+      vertexArrayObjects.data());
+  for (size_t i = 0; i < scene.layouts.size(); ++i) {
+    const auto &layout = scene.layouts[i];
+    glBindVertexArray(vertexArrayObjects[i]);
+    // Each attribute reads its own stream, through the binding of same index
+    for (size_t j = 0; j < layout.attributes.size(); ++j) {
+      const auto &attribute = layout.attributes[j];
+      glEnableVertexAttribArray(attribute.location);
+      glVertexAttribFormat(attribute.location, attribute.componentCount,
+          attribute.componentType, attribute.normalized, 0);
+      glVertexAttribBinding(attribute.location, attribute.location);
+      glBindVertexBuffer(attribute.location, arenaBuffer,
+          layout.streamOffsets[j], layout.streamStrides[j]);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arenaBuffer);
+  }
+  glBindVertexArray(0);
+  return vertexArrayObjects;
+}
+
+std::vector<GLuint> ViewerApplication::createTextureObjects(
+    const SceneData &scene) const
+{
+  std::vector<GLuint> textureObjects(scene.textures.size(), 0);
+  if (textureObjects.empty()) {
+    return textureObjects;
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(GLsizei(scene.textures.size()), textureObjects.data());
+  for (size_t i = 0; i < scene.textures.size(); ++i) {
+    const auto &texture = scene.textures[i];
+    if (texture.image < 0) {
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, textureObjects[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.wrapT);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return textureObjects;
+}
+
+void ViewerApplication::createDrawItems(const SceneData &scene,
+    SceneObjects &sceneObjects, ObjectUniformBuffer &objects) const
+{
+  auto &graph = sceneObjects.graph;
+  graph = SceneGraph{scene};
+  auto &drawItems = sceneObjects.drawItems;
+  sceneObjects.nodeSlots.assign(graph.size(), 0);
+  for (uint32_t node = 0; node < graph.size(); ++node) {
+    sceneObjects.nodeItems.push_back(uint32_t(drawItems.size()));
+    if (graph.getMesh(node) < 0) {
+      continue;
+    }
+    const auto &mesh = scene.meshes[graph.getMesh(node)];
+    const auto &modelMatrix = graph.getWorldMatrix(node);
+    sceneObjects.nodeSlots[node] = objects.add(modelMatrix);
+    for (uint32_t i = 0; i < mesh.primitiveCount; ++i) {
+      const auto primitiveIdx = mesh.firstPrimitive + i;
+      drawItems.push_back({primitiveIdx, node,
+          Frustum::transformBox(
+              scene.primitives[primitiveIdx].bounds, modelMatrix)});
+    }
+  }
+  sceneObjects.nodeItems.push_back(uint32_t(drawItems.size()));
+  sceneObjects.visibleItems.assign(drawItems.size(), 0);
+
+  auto &drawOrder = sceneObjects.drawOrder;
+  for (uint32_t i = 0; i < drawItems.size(); ++i) {
+    drawOrder.push_back(i);
+  }
+  std::sort(begin(drawOrder), end(drawOrder), [&](uint32_t lhs, uint32_t rhs) {
+    const auto &a = scene.primitives[drawItems[lhs].primitive];
+    const auto &b = scene.primitives[drawItems[rhs].primitive];
+    return std::tie(a.layout, a.material) < std::tie(b.layout, b.material);
+  });
+}
+
+uint32_t ViewerApplication::updateDrawItems(const SceneData &scene,
+    SceneObjects &sceneObjects, ObjectUniformBuffer &objects) const
+{
+  const auto &graph = sceneObjects.graph;
+  return sceneObjects.graph.update([&](uint32_t node) {
+    if (graph.getMesh(node) < 0) {
+      return;
+    }
+    const auto &modelMatrix = graph.getWorldMatrix(node);
+    objects.set(sceneObjects.nodeSlots[node], modelMatrix);
+    for (auto i = sceneObjects.nodeItems[node];
+         i < sceneObjects.nodeItems[node + 1]; ++i) {
+      auto &item = sceneObjects.drawItems[i];
+      item.bounds = Frustum::transformBox(
+          scene.primitives[item.primitive].bounds, modelMatrix);
+    }
+  });
+}
+
+ViewerApplication::SceneObjects ViewerApplication::createSceneObjects(
+    const LoadedScene &loaded, ObjectUniformBuffer &objects)
+{
+  SceneObjects sceneObjects;
+  sceneObjects.arenaBuffer = createBufferObjects(loaded.scene);
+  sceneObjects.vertexArrayObjects =
+      createVertexArrayObjects(loaded.scene, sceneObjects.arenaBuffer);
+  sceneObjects.textureObjects = createTextureObjects(loaded.scene);
+  for (const auto &layout : loaded.scene.layouts) {
+    uint32_t attributes = 0;
+    for (const auto &attribute : layout.attributes) {
+      attributes |= 1u << attribute.location;
+    }
+    sceneObjects.layoutAttributes.push_back(attributes);
+  }
+  createDrawItems(loaded.scene, sceneObjects, objects);
+  return sceneObjects;
+}
+
+void ViewerApplication::deleteSceneObjects(
+    SceneObjects &sceneObjects, ObjectUniformBuffer &objects)
+{
+  const auto &graph = sceneObjects.graph;
+  for (uint32_t node = 0; node < graph.size(); ++node) {
+    if (graph.getMesh(node) >= 0) {
+      objects.remove(sceneObjects.nodeSlots[node]);
+    }
+  }
+  glDeleteVertexArrays(GLsizei(sceneObjects.vertexArrayObjects.size()),
+      sceneObjects.vertexArrayObjects.data());
+  glDeleteTextures(GLsizei(sceneObjects.textureObjects.size()),
+      sceneObjects.textureObjects.data());
+  glDeleteBuffers(1, &sceneObjects.arenaBuffer);
+  sceneObjects = SceneObjects{};
+}
+
+ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
+    uint32_t height, const fs::path &gltfFile, const std::string &vertexShader,
+    const std::string &fragmentShader) :
     m_nWindowWidth(width),
     m_nWindowHeight(height),
     m_AppPath{appPath},
     m_AppName{m_AppPath.stem().string()},
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
-    m_ShadersRootPath{m_AppPath.parent_path() / "shaders"}
+    m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
+    m_gltfFilePath{gltfFile}
 {
+  if (!vertexShader.empty()) {
+    m_vertexShader = vertexShader;
+  }
+
+  if (!fragmentShader.empty()) {
+    m_fragmentShader = fragmentShader;
+  }
+
   ImGui::GetIO().IniFilename =
       m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
                                   // positions in this file
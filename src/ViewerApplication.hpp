@@ -7,21 +7,45 @@
 #include "utils/filesystem.hpp"
 #include "utils/gltf.hpp"
 #include "utils/images.hpp"
+#include "utils/sceneData.hpp"
+#include "utils/sceneGraph.hpp"
+#include "utils/sceneLoader.hpp"
 #include "utils/shaders.hpp"
+#include "utils/uniformBuffers.hpp"
 
 class ViewerApplication
 {
 public:
-  ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height);
+  ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height,
+      const fs::path &gltfFile, const std::string &vertexShader,
+      const std::string &fragmentShader);
 
   int run();
 
 private:
-  // A range of indices in a vector containing Vertex Array Objects
-  struct VaoRange
+  // One primitive of a mesh node
+  struct DrawItem
   {
-    GLsizei begin; // Index of first element in vertexArrayObjects
-    GLsizei count; // Number of elements in range
+    uint32_t primitive; // Index in SceneData::primitives
+    uint32_t node;      // Flat index in SceneObjects::graph
+    kln::Aabb bounds;   // World space
+  };
+
+  // GL objects of the scene being displayed, filled by AsyncSceneLoader
+  struct SceneObjects
+  {
+    GLuint arenaBuffer = 0;
+    std::vector<GLuint> vertexArrayObjects;
+    // Per layout, bit i set if it has the attribute of location i
+    std::vector<uint32_t> layoutAttributes;
+    std::vector<GLuint> textureObjects;
+    SceneGraph graph;
+    // In graph order, items of node i are [nodeItems[i], nodeItems[i + 1])
+    std::vector<DrawItem> drawItems;
+    std::vector<uint32_t> nodeItems;
+    std::vector<uint32_t> nodeSlots; // Model matrix, see ObjectUniformBuffer
+    std::vector<uint32_t> drawOrder; // Items sorted by layout then material
+    std::vector<unsigned char> visibleItems; // Per item, set by culling
   };
 
   GLsizei m_nWindowWidth = 1280;
@@ -40,15 +64,31 @@ private:
 
   fs::path m_OutputPath;
 
-  bool loadGltfFile(tinygltf::Model &model);
+  // Immutable arena holding every vertex and index of the scene, its content
+  // is copied in by AsyncSceneLoader::upload
+  GLuint createBufferObjects(const SceneData &scene);
+
+  // One vertex array per vertex layout, reading the streams of the arena
+  std::vector<GLuint> createVertexArrayObjects(
+      const SceneData &scene, GLuint arenaBuffer);
+
+  // Textures with their sampler parameters, their storage is allocated by
+  // AsyncSceneLoader::upload once their image is decoded
+  std::vector<GLuint> createTextureObjects(const SceneData &scene) const;
 
-  std::vector<GLuint> createBufferObjects(const tinygltf::Model &model);
+  // Graph, object slots and draw items of every mesh node
+  void createDrawItems(const SceneData &scene, SceneObjects &sceneObjects,
+      ObjectUniformBuffer &objects) const;
 
-  std::vector<GLuint> createVertexArrayObjects(const tinygltf::Model &model,
-      const std::vector<GLuint> &bufferObjects,
-      std::vector<VaoRange> &meshIndexToVaoRange, bool &tangentAccessor);
+  // Propagates the nodes moved since the last call to their object slots and
+  // draw item bounds, returns the number of nodes recomputed
+  uint32_t updateDrawItems(const SceneData &scene, SceneObjects &sceneObjects,
+      ObjectUniformBuffer &objects) const;
 
-  std::vector<GLuint> createTextureObjects(const tinygltf::Model &model) const;
+  SceneObjects createSceneObjects(
+      const LoadedScene &loaded, ObjectUniformBuffer &objects);
+  void deleteSceneObjects(
+      SceneObjects &sceneObjects, ObjectUniformBuffer &objects);
 
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
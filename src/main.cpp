@@ -3,6 +3,7 @@
 #include "utils/filesystem.hpp"
 
 #include <args.hxx>
+#include <iostream>
 
 std::vector<std::string> split(
     const std::string &str, const std::string &delim);
@@ -14,7 +15,29 @@ int main(int argc, char **argv)
   uint32_t width = 1280;
   uint32_t height = 720;
 
-  ViewerApplication app{fs::path{argv[0]}, width, height};
+  args::ArgumentParser parser{"Projective Geometry"};
+  args::HelpFlag help{parser, "help", "Display this help menu", {'h', "help"}};
+  args::Positional<std::string> gltfFilePath{
+      parser, "gltf_file", "Path to a glTF file to display"};
+  args::ValueFlag<std::string> vertexShader{parser, "vertex_shader",
+      "Vertex shader name, in the shaders directory", {"vs"}};
+  args::ValueFlag<std::string> fragmentShader{parser, "fragment_shader",
+      "Fragment shader name, in the shaders directory", {"fs"}};
+
+  try {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help &) {
+    std::cout << parser;
+    return 0;
+  } catch (const args::ParseError &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+
+  ViewerApplication app{fs::path{argv[0]}, width, height,
+      args::get(gltfFilePath), args::get(vertexShader),
+      args::get(fragmentShader)};
   returnCode = app.run();
 
   return returnCode;
@@ -3,19 +3,65 @@
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+// Per-instance translation for instanced draws, (0, 0, 0) otherwise since the
+// attribute is then disabled
+#ifndef NO_INSTANCES
+layout(location = 3) in vec3 aInstanceOffset;
+#endif
+#ifdef NORMAL_MAP
+// w is the handedness of the bitangent
+layout(location = 4) in vec4 aTangent;
+#endif
 
+// Variants: NO_INSTANCES for draws without instance offsets, HAS_NORMALS or
+// NO_NORMALS when it is known whether the vertices have normals, NORMAL_MAP
+// with HAS_NORMALS for vertices with tangents and a normal texture. Without
+// defines, every case but normal mapping is handled at runtime.
 out vec3 vViewSpacePosition;
+#ifndef NO_NORMALS
 out vec3 vViewSpaceNormal;
+#endif
+#ifdef NORMAL_MAP
+out vec4 vViewSpaceTangent;
+#endif
 out vec2 vTexCoords;
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uNormalMatrix;
+// Uploaded once per frame, see uniformBuffers.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    mat4 uViewProjMatrix;
+    mat4 uSkyViewProjMatrix;
+    vec4 uLightDirection;
+    vec4 uLightIntensity;
+};
+
+// Slot of the drawn object
+layout(std140) uniform ObjectUniforms
+{
+    mat4 uModelMatrix;
+    mat4 uNormalMatrix;
+};
 
 void main()
 {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
-	vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0)));
+    vec4 position = uModelMatrix * vec4(aPosition, 1);
+#ifndef NO_INSTANCES
+    position += vec4(aInstanceOffset, 0);
+#endif
+    vViewSpacePosition = vec3(uViewMatrix * position);
+#if defined(HAS_NORMALS)
+	vViewSpaceNormal = normalize(mat3(uViewMatrix) * mat3(uNormalMatrix) * aNormal);
+#elif !defined(NO_NORMALS)
+	// (0, 0, 0) if the attribute is disabled, see normals.fs.glsl
+	vec3 normal = mat3(uViewMatrix) * mat3(uNormalMatrix) * aNormal;
+	vViewSpaceNormal = dot(normal, normal) > 0.0 ? normalize(normal) : vec3(0);
+#endif
+#ifdef NORMAL_MAP
+	// Tangents follow the surface, like positions
+	vViewSpaceTangent = vec4(normalize(mat3(uViewMatrix) * mat3(uModelMatrix) * aTangent.xyz), aTangent.w);
+#endif
 	vTexCoords = aTexCoords;
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
+    gl_Position =  uViewProjMatrix * position;
 }
\ No newline at end of file
@@ -1,14 +1,47 @@
 #version 330
 
 in vec3 vViewSpacePosition;
+#ifndef NO_NORMALS
 in vec3 vViewSpaceNormal;
+#endif
+#ifdef NORMAL_MAP
+in vec4 vViewSpaceTangent;
+#endif
 in vec2 vTexCoords;
 
+#ifdef NORMAL_MAP
+uniform sampler2D uNormalTexture;
+uniform float uNormalScale;
+#endif
+
 out vec3 fColor;
 
+// Normal of the face, for vertices without normals
+vec3 getFaceNormal()
+{
+   return normalize(cross(dFdx(vViewSpacePosition), dFdy(vViewSpacePosition)));
+}
+
 void main()
 {
+#if defined(NO_NORMALS)
+   vec3 viewSpaceNormal = getFaceNormal();
+#elif defined(HAS_NORMALS)
    // Need another normalization because interpolation of vertex attributes does not maintain unit length
    vec3 viewSpaceNormal = normalize(vViewSpaceNormal);
+#else
+   // Derivatives out of the branch, they are undefined in non-uniform control flow
+   vec3 faceNormal = getFaceNormal();
+   vec3 viewSpaceNormal = dot(vViewSpaceNormal, vViewSpaceNormal) > 0.0 ? normalize(vViewSpaceNormal) : faceNormal;
+#endif
+#ifdef NORMAL_MAP
+   // Tangent space normal of the texture, scaled as in the glTF spec, the
+   // interpolated tangent is made orthogonal to the normal again
+   vec3 tangent = normalize(vViewSpaceTangent.xyz - dot(vViewSpaceTangent.xyz, viewSpaceNormal) * viewSpaceNormal);
+   vec3 bitangent = cross(viewSpaceNormal, tangent) * vViewSpaceTangent.w;
+   vec3 mappedNormal = texture(uNormalTexture, vTexCoords).rgb * 2.0 - 1.0;
+   mappedNormal.xy *= uNormalScale;
+   viewSpaceNormal = normalize(mat3(tangent, bitangent, viewSpaceNormal) * mappedNormal);
+#endif
    fColor = viewSpaceNormal;
 }
\ No newline at end of file
@@ -4,10 +4,23 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 vTexCoords;
 
-uniform mat4 uModelViewProjMatrix;
+// Same block as forward.vs.glsl
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    mat4 uViewProjMatrix;
+    mat4 uSkyViewProjMatrix;
+    vec4 uLightDirection;
+    vec4 uLightIntensity;
+};
+
+// aPos is a vertex of the 2x2x2 cube shared with the scene (see
+// GeometryRegistry), the skybox is 200 units wide
+const float skyHalfSize = 100.0;
 
 void main()
 {
     vTexCoords = aPos;
-    gl_Position =  uModelViewProjMatrix * vec4(aPos, 1);
+    gl_Position =  uSkyViewProjMatrix * vec4(skyHalfSize * aPos, 1);
 }
\ No newline at end of file
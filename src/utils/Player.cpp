@@ -37,58 +37,78 @@ void Player::applyGravity()
   // std::cout << verticalVelocity << std::endl;
 }
 
+// Sweeps the player from its position to target and slides the remaining
+// motion along every surface that is hit
+void Player::moveAndSlide(const kln::point &target)
+{
+  glm::vec3 current{position.x(), position.y(), position.z()};
+  glm::vec3 motion = glm::vec3(target.x(), target.y(), target.z()) - current;
+  isGrounded = false;
+
+  for (int i = 0; i < maxSlides && glm::length(motion) > 0.f; ++i) {
+    const auto end = current + motion;
+    kln::RayHit hit;
+    if (!bbox.sweep(kln::point{current.x, current.y, current.z},
+            kln::point{end.x, end.y, end.z}, 0.f, hit)) {
+      current = end;
+      break;
+    }
+
+    if (hit.normal.y > 0.7f) {
+      isGrounded = true;
+      verticalVelocity = std::max(verticalVelocity, 0.f);
+    } else if (hit.normal.y < -0.7f) {
+      verticalVelocity = std::min(verticalVelocity, 0.f); // Hit a ceiling
+    }
+
+    // Stop on the contact plane and keep the tangential part of the rest
+    const auto remaining = (1.f - hit.distance) * motion;
+    current = hit.point + skinWidth * hit.normal;
+    motion = remaining - glm::dot(remaining, hit.normal) * hit.normal;
+  }
+
+  position = kln::point{current.x, current.y, current.z};
+}
+
 void Player::update()
 {
+  previousPosition = position;
   applyGravity();
 
   // Apply jumping motion (always affects position)
   vertT = kln::translator(verticalVelocity * deltaTime, 0, 1, 0);
 
-  auto newPos = leftT(position);
-  if (!bbox.globalCollidesWith(newPos)) {
-    position = newPos;
-  }
-
-  newPos = forwardT(position);
-  if (!bbox.globalCollidesWith(newPos)) {
-    position = newPos;
-  }
-
-  newPos = vertT(position);
-  bbox.globalCollidesWith(position);
-  if (bbox.globalCollidesWith(newPos)) {
-    isGrounded = true;
-    verticalVelocity = 0.f;
-  } else {
-    position = newPos;
-    isGrounded = false;
-  }
+  // The whole motion of the tick is resolved by a single swept query (plus
+  // one per slide), so fast moves can't tunnel through thin boxes
+  const auto totalT = forwardT * leftT * vertT;
+  moveAndSlide(totalT(position));
 
   auto swingT = line.restrictPosition(position, isGrounded, getPos());
   position = swingT(position);
+}
 
-  // // Apply combined transformations
-  // const auto totalT = forwardT * leftT * vertT;
-  // position = totalT(position);
-
+// Called once per frame after the simulation steps, so that the movement
+// input of a frame applies to every step taken during that frame
+void Player::clearInput()
+{
   forwardT = kln::translator(); // Identity
   leftT = kln::translator();    // Identity
+}
 
-  // if (!isGrounded) {
-  //   newPos = forwardT(position);
-  //   if (!bbox.globalCollidesWith(newPos)) {
-  //     position = newPos;
-  //   }
-  // }
-
-  camera.updatePos(getPos());
-  // line.updateStartPos(getPos());
+// Places the camera between the last two simulated positions, alpha being
+// the fraction of tick elapsed since the last update()
+void Player::interpolateCamera(float alpha)
+{
+  const glm::vec3 previous{
+      previousPosition.x(), previousPosition.y(), previousPosition.z()};
+  const glm::vec3 current{position.x(), position.y(), position.z()};
+  camera.updatePos(glm::mix(previous, current, alpha) + glm::vec3(0, 0.5f, 0));
 }
 
-void Player::drawLine(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
-    UniformHandler handler) const
+void Player::drawLine(
+    GLStateCache &state, ObjectUniformBuffer &objects, Frustum *frustum) const
 {
-  line.draw(viewMatrix, projMatrix, handler);
+  line.draw(state, objects, frustum);
 }
 
 void Player::createLine()
@@ -22,23 +22,30 @@ public:
   void moveLeft(float speed);
   void jump();
   void update();
-  void drawLine(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
-      UniformHandler handler) const;
+  void clearInput();
+  void setDeltaTime(float dt) { deltaTime = dt; }
+  void interpolateCamera(float alpha);
+  void drawLine(GLStateCache &state, ObjectUniformBuffer &objects,
+      Frustum *frustum = nullptr) const;
   void createLine();
   void clearLine();
   const glm::vec3 getPos() const;
 
   kln::point position;
+  kln::point previousPosition = position; // Before the last update()
   LineCustom line;
 
 private:
   void applyGravity();
+  void moveAndSlide(const kln::point &target);
   float maxSpeed = 3.0f;
   float currentSpeed = 0.f;
   float gravity = -9.81f;
   float jumpStrength = 5.0f;
   float verticalVelocity = 0.f;
-  float deltaTime = 0.032f;
+  float deltaTime = 0.032f; // Simulation step, see FixedTimestep
+  float skinWidth = 0.001f; // Distance kept between the player and the boxes
+  int maxSlides = 3;        // Sweeps per tick when sliding along surfaces
   bool isGrounded = false, isHooked = false;
   kln::translator forwardT;
   kln::translator leftT;
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "bvh.hpp"
+#include "colliderStore.hpp"
+#include "collisionKernels.hpp"
+#include <array>
 #include <glm/vec3.hpp>
 #include <iostream>
 #include <klein/klein.hpp>
@@ -23,9 +27,16 @@ public:
 
   Transformation(const point &pos) : _pos{pos} {}
 
-  const std::vector<plane> getPlanes() const
+  // Boxes span [-1, 1] around their position, see getPlanes()
+  Aabb getBounds() const
   {
-    std::vector<plane> planes(6);
+    const glm::vec3 center{_pos.x(), _pos.y(), _pos.z()};
+    return {center - glm::vec3(1), center + glm::vec3(1)};
+  }
+
+  std::array<plane, 6> getPlanes() const
+  {
+    std::array<plane, 6> planes;
     float scale = _scale.x;
     kln::plane localPlanes[6] = {
         {1, 0, 0, 1 - _pos.x()},  // +X
@@ -61,26 +72,129 @@ public:
   }
 };
 
+// Nearest intersection returned by the Bbox ray and segment queries
+struct RayHit
+{
+  float distance = 0.f; // Along the normalized direction (ray) or in [0, 1]
+                        // (segment)
+  glm::vec3 point{0};
+  glm::vec3 normal{0}; // Outward normal of the face that was hit
+  plane facePlane;     // Plane of that face, facing outward
+};
+
 class Bbox
 {
 private:
   std::vector<Transformation> transfos;
+  // Broadphase over transfos and their planes stored in the BVH slot order
+  // (so that a leaf is a contiguous range of colliders), rebuilt lazily by the
+  // first query following an add() so that adding many boxes in a row only
+  // costs one build
+  mutable Bvh bvh;
+  mutable ColliderStore colliders;
+  mutable bool bvhDirty = false;
+  // Leaf test: a leaf holds Bvh::maxLeafSize colliders, which fill the lanes
+  // of SSE4.1. Wider kernels would mostly test padding, and AVX-512 would
+  // lower the clock for it, so they are kept for the batch scans.
+  static_assert(Bvh::maxLeafSize <= 4, "Leaves fit in one SSE4.1 iteration");
+  ContainsAnyKernel containsAny = getContainsAnyKernel(SimdLevel::Sse41);
+  // Up to this many colliders, batches scan them all with the widest kernel
+  // instead of walking the BVH per point
+  static constexpr size_t batchScanLimit = 64;
+
+  bool castRay(const glm::vec3 &origin, const glm::vec3 &unitDir,
+      float maxDistance, float radius, bool sweeping, RayHit &hit) const
+  {
+    const auto invDir = 1.f / unitDir;
+    bool found = false;
+    getBvh().queryRay(origin, unitDir, maxDistance, radius,
+        [&](uint32_t idx, float &tMax) {
+          const auto bounds = transfos[idx].getBounds().inflated(radius);
+          float tEnter, tExit;
+          if (!bounds.intersectRay(origin, invDir, tMax, tEnter, tExit) ||
+              (found && tEnter >= hit.distance)) {
+            return;
+          }
+          glm::vec3 normal;
+          if (tEnter > 0.f) {
+            normal = bounds.faceNormal(origin + tEnter * unitDir);
+          } else if (sweeping) {
+            normal = bounds.faceNormal(origin);
+            if (glm::dot(normal, unitDir) >= 0.f) {
+              return; // Moving along or out of an overlapped box
+            }
+          } else {
+            normal = -unitDir;
+          }
+          found = true;
+          hit.distance = tEnter;
+          hit.point = origin + tEnter * unitDir;
+          hit.normal = normal;
+          tMax = tEnter;
+        });
+    if (found) {
+      hit.facePlane = plane(hit.normal.x, hit.normal.y, hit.normal.z,
+          -glm::dot(hit.normal, hit.point));
+    }
+    return found;
+  }
+
+  const Bvh &getBvh() const
+  {
+    if (bvhDirty) {
+      std::vector<Aabb> bounds;
+      bounds.reserve(transfos.size());
+      for (const auto &transfo : transfos) {
+        bounds.push_back(transfo.getBounds());
+      }
+      bvh.build(bounds);
+      colliders.clear();
+      colliders.reserve(transfos.size());
+      for (uint32_t slot = 0; slot < bvh.size(); ++slot) {
+        colliders.push_back(transfos[bvh.primitive(slot)].getPlanes());
+      }
+      bvhDirty = false;
+    }
+    return bvh;
+  }
 
 public:
   void add(const Transformation &&transfo)
   {
     transfos.push_back(std::move(transfo));
+    bvhDirty = true;
   }
 
-  bool globalCollidesWith(const point &targetPos)
+  bool globalCollidesWith(const point &targetPos) const
   {
-    // std::cout << transfos.size() << std::endl;
-    for (const auto &transfo : transfos) {
-      bool collide = transfo.collidesWith(targetPos);
-      if (collide)
-        return true;
+    const glm::vec3 p{targetPos.x(), targetPos.y(), targetPos.z()};
+    return globalCollidesWith(p);
+  }
+
+  bool globalCollidesWith(const glm::vec3 &p) const
+  {
+    return getBvh().queryPointLeaves(p, [&](uint32_t first, uint32_t count) {
+      return containsAny(colliders, first, first + count, p);
+    });
+  }
+
+  // Batched version for many points (particles, agents) sharing the same
+  // collision world: results[i] = globalCollidesWith(points[i])
+  void globalCollidesWith(
+      const glm::vec3 *points, size_t pointCount, bool *results) const
+  {
+    const auto &tree = getBvh();
+    if (colliders.size() <= batchScanLimit) {
+      containsAnyBatch(colliders, points, pointCount, results);
+      return;
+    }
+    for (size_t i = 0; i < pointCount; ++i) {
+      const auto &p = points[i];
+      results[i] =
+          tree.queryPointLeaves(p, [&](uint32_t first, uint32_t count) {
+            return containsAny(colliders, first, first + count, p);
+          });
     }
-    return false;
   }
 
   glm::vec3 getDirection(const kln::line &line) const
@@ -88,53 +202,72 @@ public:
     return glm::normalize(glm::vec3(line.e23(), line.e31(), line.e12()));
   }
 
+  // Exact nearest hit of the ray origin + t * direction, t in [0, maxDistance]
+  // (direction does not need to be normalized, distances are measured along
+  // its normalized value). A ray starting inside a box hits it at t = 0.
+  bool raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+      float maxDistance, RayHit &hit) const
+  {
+    return castRay(
+        origin, glm::normalize(direction), maxDistance, 0.f, false, hit);
+  }
+
+  // Continuous collision of a sphere of the given radius (0 for a point)
+  // moving from start to end, boxes being inflated by the radius.
+  // hit.distance is the time of impact in [0, 1] and hit.facePlane the
+  // contact plane. Boxes the sphere already overlaps only block it if it
+  // moves deeper into them, so that a body resting on a face can slide along
+  // it or leave it.
+  bool sweep(const kln::point &start, const kln::point &end, float radius,
+      RayHit &hit) const
+  {
+    const glm::vec3 a{start.x(), start.y(), start.z()};
+    const glm::vec3 b{end.x(), end.y(), end.z()};
+    const auto length = glm::length(b - a);
+    if (length <= 0.f ||
+        !castRay(a, (b - a) / length, length, radius, true, hit)) {
+      return false;
+    }
+    hit.distance /= length;
+    return true;
+  }
+
+  // Nearest hit on the segment [start, end], hit.distance is the fraction of
+  // the segment travelled before the hit
+  bool intersectSegment(
+      const kln::point &start, const kln::point &end, RayHit &hit) const
+  {
+    const glm::vec3 a{start.x(), start.y(), start.z()};
+    const glm::vec3 b{end.x(), end.y(), end.z()};
+    const auto length = glm::length(b - a);
+    if (length <= 0.f || !raycast(a, b - a, length, hit)) {
+      return false;
+    }
+    hit.distance /= length;
+    return true;
+  }
+
   bool computeColliderCoords(
       const kln::point &start, const kln::point &end, glm::vec3 &output) const
   {
-    auto line = end & start;
-    for (const auto &transfo : transfos) {
-      const auto planes = transfo.getPlanes();
-      const auto plane = planes[0];
-      // for (const auto plane : planes) {
-      auto point = line ^ plane;
-      std::cout << plane.x() << ", " << plane.y() << ", " << plane.z() << ", "
-                << plane.d() << std::endl;
-      output = glm::vec3(point.x(), point.y(), point.z());
-      return true;
-      // if (transfo.collidesWith(point)) {
-      //   output = glm::vec3(point.x(), point.y(), point.z());
-      //   return true;
-      // }
-      // }
+    RayHit hit;
+    if (!intersectSegment(start, end, hit)) {
+      return false;
     }
-    return false;
+    output = hit.point;
+    return true;
   }
 
   bool findIntersection(const kln::point &start, const glm::vec3 &direction,
       float maxDistance, glm::vec3 &output) const
   {
-    float stepSize = 0.1f; // Step size for checking (adjust for precision)
-    int nbPlanes = 6;
-    const auto T =
-        kln::translator(stepSize, direction.x, direction.y, direction.z);
-    for (const auto &transfo : transfos) {
-      auto temp = start;
-      for (float t = 0; t <= maxDistance; t += stepSize) {
-        // Generate new point along the direction
-        kln::point samplePoint = T(temp);
-
-        // If intersection is valid (negative sign means in front)
-        if (transfo.collidesWith(samplePoint)) {
-          output = glm::vec3(samplePoint.x(), samplePoint.y(), samplePoint.z());
-          // std::cout << samplePoint.x() << ", " << samplePoint.y() << ", "
-          //           << samplePoint.z() << std::endl;
-          return true;
-        }
-
-        temp = samplePoint;
-      }
+    RayHit hit;
+    if (!raycast(glm::vec3(start.x(), start.y(), start.z()), direction,
+            maxDistance, hit)) {
+      return false; // No intersection found within range
     }
-    return false; // No intersection found within range
+    output = hit.point;
+    return true;
   }
 };
 } // namespace kln
\ No newline at end of file
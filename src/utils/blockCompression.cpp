@@ -0,0 +1,254 @@
+#include "blockCompression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+using Block = std::array<std::array<int, 4>, 16>; // RGBA of 4x4 pixels
+
+void readBlock(const unsigned char *pixels, int width, int height, int x,
+    int y, Block &block)
+{
+  for (int j = 0; j < 4; ++j) {
+    const auto row = std::min(y + j, height - 1);
+    for (int i = 0; i < 4; ++i) {
+      const auto pixel =
+          pixels + (size_t(row) * width + std::min(x + i, width - 1)) * 4;
+      for (int c = 0; c < 4; ++c) {
+        block[4 * j + i][c] = pixel[c];
+      }
+    }
+  }
+}
+
+// Corners of the bounding box of the first channelCount channels, inset by
+// 1/16 of its size, on the diagonal that follows the colors: channels going
+// down while green goes up are swapped
+void getEndpoints(const Block &block, int channelCount,
+    std::array<int, 4> &low, std::array<int, 4> &high)
+{
+  low = high = block[0];
+  std::array<int, 4> sum{}; // 16 times the mean
+  for (const auto &pixel : block) {
+    for (int c = 0; c < channelCount; ++c) {
+      low[c] = std::min(low[c], pixel[c]);
+      high[c] = std::max(high[c], pixel[c]);
+      sum[c] += pixel[c];
+    }
+  }
+  for (int c = 0; c < channelCount; ++c) {
+    const auto inset = (high[c] - low[c]) >> 4;
+    low[c] += inset;
+    high[c] -= inset;
+  }
+  for (int c = 0; c < channelCount; ++c) {
+    if (c == 1) {
+      continue;
+    }
+    int covariance = 0;
+    for (const auto &pixel : block) {
+      covariance += (16 * pixel[c] - sum[c]) * (16 * pixel[1] - sum[1]);
+    }
+    if (covariance < 0) {
+      std::swap(low[c], high[c]);
+    }
+  }
+}
+
+int getDistance(
+    const std::array<int, 4> &a, const std::array<int, 4> &b, int channelCount)
+{
+  int distance = 0;
+  for (int c = 0; c < channelCount; ++c) {
+    distance += (a[c] - b[c]) * (a[c] - b[c]);
+  }
+  return distance;
+}
+
+uint16_t packRgb565(const std::array<int, 4> &color)
+{
+  return uint16_t((color[0] * 31 + 127) / 255 << 11 |
+                  (color[1] * 63 + 127) / 255 << 5 |
+                  (color[2] * 31 + 127) / 255);
+}
+
+// With the bits replicated, like the decoders do
+std::array<int, 4> unpackRgb565(uint16_t color)
+{
+  const auto r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+  return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255};
+}
+
+void compressBc1Block(const Block &block, unsigned char *out)
+{
+  std::array<int, 4> low, high;
+  getEndpoints(block, 3, low, high);
+  auto color0 = packRgb565(high);
+  auto color1 = packRgb565(low);
+  // color0 > color1 selects the 4 colors mode, the other one has black
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    std::array<std::array<int, 4>, 4> palette;
+    palette[0] = unpackRgb565(color0);
+    palette[1] = unpackRgb565(color1);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; ++i) {
+      uint32_t best = 0;
+      for (uint32_t j = 1; j < 4; ++j) {
+        if (getDistance(block[i], palette[j], 3) <
+            getDistance(block[i], palette[best], 3)) {
+          best = j;
+        }
+      }
+      indices |= best << (2 * i);
+    }
+  }
+  const unsigned char bytes[8] = {(unsigned char)(color0 & 0xff),
+      (unsigned char)(color0 >> 8), (unsigned char)(color1 & 0xff),
+      (unsigned char)(color1 >> 8), (unsigned char)(indices & 0xff),
+      (unsigned char)(indices >> 8 & 0xff),
+      (unsigned char)(indices >> 16 & 0xff), (unsigned char)(indices >> 24)};
+  std::memcpy(out, bytes, sizeof(bytes));
+}
+
+// Least significant bits first, like the fields of BC7 blocks
+struct BitWriter
+{
+  void write(uint32_t value, int bitCount)
+  {
+    for (int i = 0; i < bitCount; ++i, ++position) {
+      const auto bit = (value >> i) & 1;
+      out[position / 8] |= (unsigned char)(bit << position % 8);
+    }
+  }
+
+  unsigned char *out;
+  int position = 0;
+};
+
+// 7 bits per channel and a shared lowest bit, the p-bit, chosen to minimize
+// the error of the endpoint
+void quantizeBc7Endpoint(const std::array<int, 4> &endpoint,
+    std::array<int, 4> &quantized, int &pBit)
+{
+  int bestError = -1;
+  for (int p = 0; p < 2; ++p) {
+    std::array<int, 4> candidate;
+    int error = 0;
+    for (int c = 0; c < 4; ++c) {
+      candidate[c] = std::clamp((endpoint[c] - p + 1) >> 1, 0, 127);
+      const auto decoded = candidate[c] << 1 | p;
+      error += (decoded - endpoint[c]) * (decoded - endpoint[c]);
+    }
+    if (bestError < 0 || error < bestError) {
+      bestError = error;
+      quantized = candidate;
+      pBit = p;
+    }
+  }
+}
+
+void compressBc7Block(const Block &block, unsigned char *out)
+{
+  static const int weights[16] = {
+      0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+  std::array<int, 4> low, high;
+  getEndpoints(block, 4, low, high);
+  std::array<std::array<int, 4>, 2> endpoints;
+  int pBits[2];
+  quantizeBc7Endpoint(low, endpoints[0], pBits[0]);
+  quantizeBc7Endpoint(high, endpoints[1], pBits[1]);
+
+  std::array<std::array<int, 4>, 16> palette;
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      const auto e0 = endpoints[0][c] << 1 | pBits[0];
+      const auto e1 = endpoints[1][c] << 1 | pBits[1];
+      palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+    }
+  }
+  int indices[16];
+  for (int i = 0; i < 16; ++i) {
+    indices[i] = 0;
+    for (int j = 1; j < 16; ++j) {
+      if (getDistance(block[i], palette[j], 4) <
+          getDistance(block[i], palette[indices[i]], 4)) {
+        indices[i] = j;
+      }
+    }
+  }
+  // The first index is stored without its highest bit, which must be 0
+  if (indices[0] >= 8) {
+    std::swap(endpoints[0], endpoints[1]);
+    std::swap(pBits[0], pBits[1]);
+    for (auto &index : indices) {
+      index = 15 - index;
+    }
+  }
+
+  std::memset(out, 0, 16);
+  BitWriter writer{out};
+  writer.write(1 << 6, 7); // Mode 6
+  for (int c = 0; c < 4; ++c) {
+    writer.write(endpoints[0][c], 7);
+    writer.write(endpoints[1][c], 7);
+  }
+  writer.write(pBits[0], 1);
+  writer.write(pBits[1], 1);
+  writer.write(indices[0], 3);
+  for (int i = 1; i < 16; ++i) {
+    writer.write(indices[i], 4);
+  }
+}
+} // namespace
+
+bool hasTransparentPixels(const unsigned char *pixels, size_t pixelCount)
+{
+  for (size_t i = 0; i < pixelCount; ++i) {
+    if (pixels[4 * i + 3] != 255) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void compressImage(const unsigned char *pixels, int width, int height,
+    PixelFormat format, unsigned char *blocks)
+{
+  const auto blockBytes = format == PixelFormat::Bc1 ? 8 : 16;
+  Block block;
+  for (int y = 0; y < height; y += 4) {
+    for (int x = 0; x < width; x += 4) {
+      readBlock(pixels, width, height, x, y, block);
+      if (format == PixelFormat::Bc1) {
+        compressBc1Block(block, blocks);
+      } else {
+        compressBc7Block(block, blocks);
+      }
+      blocks += blockBytes;
+    }
+  }
+}
+
+std::vector<unsigned char> compressMipChain(int width, int height,
+    const std::vector<unsigned char> &pixels, PixelFormat format)
+{
+  const auto levelCount = getMipLevelCount(width, height);
+  std::vector<unsigned char> blocks(
+      getMipLevelOffset(width, height, levelCount, format));
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    compressImage(pixels.data() + getMipLevelOffset(width, height, level),
+        std::max(width >> level, 1), std::max(height >> level, 1), format,
+        blocks.data() + getMipLevelOffset(width, height, level, format));
+  }
+  return blocks;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "images.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Encoders of the block formats of PixelFormat, fast rather than optimal:
+// endpoints come from the bounding box of the colors of each block instead of
+// a search. BC7 blocks only use mode 6 (one subset, RGBA endpoints, 16
+// weights).
+
+// True if some pixels of an RGBA8 image aren't opaque
+bool hasTransparentPixels(const unsigned char *pixels, size_t pixelCount);
+
+// Encodes an RGBA8 image into blocks, the last blocks of a row or column
+// repeat its edge. blocks holds getMipLevelOffset(width, height, 1, format)
+// bytes.
+void compressImage(const unsigned char *pixels, int width, int height,
+    PixelFormat format, unsigned char *blocks);
+
+// Encodes every level of an RGBA8 mip chain (see generateMipChain)
+std::vector<unsigned char> compressMipChain(int width, int height,
+    const std::vector<unsigned char> &pixels, PixelFormat format);
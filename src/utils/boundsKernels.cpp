@@ -0,0 +1,163 @@
+#include "boundsKernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#define BOUNDS_X86 1
+#include <immintrin.h>
+#endif
+
+// Same scheme as the collision kernels: SSE is always there, AVX2 is only
+// called after a runtime check
+#if defined(__GNUC__) || defined(__clang__)
+#define BOUNDS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BOUNDS_TARGET(isa)
+#endif
+
+namespace kln
+{
+namespace
+{
+Aabb positionBoundsScalar(
+    const unsigned char *data, std::size_t stride, std::size_t count)
+{
+  Aabb bounds;
+  for (std::size_t i = 0; i < count; ++i) {
+    glm::vec3 position;
+    std::memcpy(&position, data + i * stride, sizeof(position));
+    bounds.grow(position);
+  }
+  return bounds;
+}
+
+#ifdef BOUNDS_X86
+// Tightly packed positions are read as a plain float stream: a block of
+// `width` floats holds width / 3 positions and lane i always holds the
+// component i % 3, so the lanes are only sorted out once at the end
+Aabb reduceLanes(const float *lo, const float *hi, std::size_t width)
+{
+  Aabb bounds;
+  for (std::size_t i = 0; i < width; ++i) {
+    bounds.min[i % 3] = std::min(bounds.min[i % 3], lo[i]);
+    bounds.max[i % 3] = std::max(bounds.max[i % 3], hi[i]);
+  }
+  return bounds;
+}
+
+// 4 positions per iteration when packed, else one position per 4-float load
+Aabb positionBoundsSse(
+    const unsigned char *data, std::size_t stride, std::size_t count)
+{
+  const auto p = reinterpret_cast<const float *>(data);
+  __m128 lo0 = _mm_set1_ps(std::numeric_limits<float>::max());
+  __m128 hi0 = _mm_set1_ps(std::numeric_limits<float>::lowest());
+  std::size_t i = 0;
+  if (stride == 3 * sizeof(float)) {
+    __m128 lo1 = lo0, lo2 = lo0;
+    __m128 hi1 = hi0, hi2 = hi0;
+    for (; i + 4 <= count; i += 4) {
+      const auto a = _mm_loadu_ps(p + 3 * i);
+      const auto b = _mm_loadu_ps(p + 3 * i + 4);
+      const auto c = _mm_loadu_ps(p + 3 * i + 8);
+      lo0 = _mm_min_ps(lo0, a);
+      hi0 = _mm_max_ps(hi0, a);
+      lo1 = _mm_min_ps(lo1, b);
+      hi1 = _mm_max_ps(hi1, b);
+      lo2 = _mm_min_ps(lo2, c);
+      hi2 = _mm_max_ps(hi2, c);
+    }
+    alignas(16) float lo[12], hi[12];
+    _mm_store_ps(lo, lo0);
+    _mm_store_ps(lo + 4, lo1);
+    _mm_store_ps(lo + 8, lo2);
+    _mm_store_ps(hi, hi0);
+    _mm_store_ps(hi + 4, hi1);
+    _mm_store_ps(hi + 8, hi2);
+    auto bounds = reduceLanes(lo, hi, 12);
+    bounds.grow(positionBoundsScalar(data + i * stride, stride, count - i));
+    return bounds;
+  }
+  // Interleaved: the 4th float belongs to the next attribute, except for the
+  // last position which may end the buffer
+  for (; i + 1 < count && stride >= 4 * sizeof(float); ++i) {
+    const auto a = _mm_loadu_ps(
+        reinterpret_cast<const float *>(data + i * stride));
+    lo0 = _mm_min_ps(lo0, a);
+    hi0 = _mm_max_ps(hi0, a);
+  }
+  alignas(16) float lo[4], hi[4];
+  _mm_store_ps(lo, lo0);
+  _mm_store_ps(hi, hi0);
+  auto bounds = reduceLanes(lo, hi, 3);
+  bounds.grow(positionBoundsScalar(data + i * stride, stride, count - i));
+  return bounds;
+}
+
+// 8 positions per iteration when packed, interleaved positions don't fill
+// 8 lanes and go to the SSE kernel
+BOUNDS_TARGET("avx2")
+Aabb positionBoundsAvx2(
+    const unsigned char *data, std::size_t stride, std::size_t count)
+{
+  if (stride != 3 * sizeof(float)) {
+    return positionBoundsSse(data, stride, count);
+  }
+  const auto p = reinterpret_cast<const float *>(data);
+  __m256 lo0 = _mm256_set1_ps(std::numeric_limits<float>::max());
+  __m256 hi0 = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+  __m256 lo1 = lo0, lo2 = lo0;
+  __m256 hi1 = hi0, hi2 = hi0;
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto a = _mm256_loadu_ps(p + 3 * i);
+    const auto b = _mm256_loadu_ps(p + 3 * i + 8);
+    const auto c = _mm256_loadu_ps(p + 3 * i + 16);
+    lo0 = _mm256_min_ps(lo0, a);
+    hi0 = _mm256_max_ps(hi0, a);
+    lo1 = _mm256_min_ps(lo1, b);
+    hi1 = _mm256_max_ps(hi1, b);
+    lo2 = _mm256_min_ps(lo2, c);
+    hi2 = _mm256_max_ps(hi2, c);
+  }
+  alignas(32) float lo[24], hi[24];
+  _mm256_store_ps(lo, lo0);
+  _mm256_store_ps(lo + 8, lo1);
+  _mm256_store_ps(lo + 16, lo2);
+  _mm256_store_ps(hi, hi0);
+  _mm256_store_ps(hi + 8, hi1);
+  _mm256_store_ps(hi + 16, hi2);
+  auto bounds = reduceLanes(lo, hi, 24);
+  bounds.grow(positionBoundsSse(data + i * stride, stride, count - i));
+  return bounds;
+}
+#endif
+} // namespace
+
+PositionBoundsKernel getPositionBoundsKernel(SimdLevel level)
+{
+  if (level > detectSimdLevel()) {
+    level = detectSimdLevel();
+  }
+  switch (level) {
+#ifdef BOUNDS_X86
+  case SimdLevel::Avx512:
+  case SimdLevel::Avx2:
+    return positionBoundsAvx2;
+  case SimdLevel::Sse41:
+    return positionBoundsSse;
+#endif
+  default:
+    return positionBoundsScalar;
+  }
+}
+
+PositionBoundsKernel getPositionBoundsKernel()
+{
+  static const auto kernel = getPositionBoundsKernel(detectSimdLevel());
+  return kernel;
+}
+} // namespace kln
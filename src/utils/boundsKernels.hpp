@@ -0,0 +1,26 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "collisionKernels.hpp"
+
+#include <cstddef>
+
+namespace kln
+{
+// Returns the bounds of count positions of 3 floats, stride bytes apart (a
+// glTF POSITION accessor), empty if count is 0
+using PositionBoundsKernel = Aabb (*)(
+    const unsigned char *data, std::size_t stride, std::size_t count);
+
+// Kernel for a given level, falling back to the best supported level below it
+PositionBoundsKernel getPositionBoundsKernel(SimdLevel level);
+
+// Kernel for detectSimdLevel(), resolved once
+PositionBoundsKernel getPositionBoundsKernel();
+
+inline Aabb scanPositionBounds(
+    const unsigned char *data, std::size_t stride, std::size_t count)
+{
+  return getPositionBoundsKernel()(data, stride, count);
+}
+} // namespace kln
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace kln
+{
+// Axis aligned bounding box, used as the bounding volume of the Bvh nodes
+struct Aabb
+{
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+  void grow(const glm::vec3 &p)
+  {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void grow(const Aabb &box)
+  {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+
+  glm::vec3 center() const { return 0.5f * (min + max); }
+
+  // Box grown by r on every side
+  Aabb inflated(float r) const
+  {
+    return {min - glm::vec3(r), max + glm::vec3(r)};
+  }
+
+  bool contains(const glm::vec3 &p) const
+  {
+    return p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x &&
+           p.y <= max.y && p.z <= max.z;
+  }
+
+  // Outward normal of the face nearest to p
+  glm::vec3 faceNormal(const glm::vec3 &p) const
+  {
+    const auto rel = (p - center()) / glm::max(0.5f * (max - min), 1e-6f);
+    const auto absRel = glm::abs(rel);
+    const int axis = absRel.x > absRel.y ? (absRel.x > absRel.z ? 0 : 2)
+                                         : (absRel.y > absRel.z ? 1 : 2);
+    glm::vec3 normal{0.f};
+    normal[axis] = rel[axis] < 0.f ? -1.f : 1.f;
+    return normal;
+  }
+
+  // Slab test, returns the parametric range [tEnter, tExit] of the ray inside
+  // the box clipped to [0, tMax]
+  bool intersectRay(const glm::vec3 &origin, const glm::vec3 &invDir,
+      float tMax, float &tEnter, float &tExit) const
+  {
+    const auto t0 = (min - origin) * invDir;
+    const auto t1 = (max - origin) * invDir;
+    const auto tNear = glm::min(t0, t1);
+    const auto tFar = glm::max(t0, t1);
+    tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return tEnter <= tExit;
+  }
+};
+
+// Bounding volume hierarchy over a set of boxes. Leaves reference a
+// contiguous range of primitive indices, so a point, segment or ray query only
+// visits O(log n) nodes instead of every box.
+class Bvh
+{
+public:
+  static constexpr uint32_t maxLeafSize = 4;
+
+  void build(const std::vector<Aabb> &boxes)
+  {
+    m_Nodes.clear();
+    m_Indices.resize(boxes.size());
+    for (uint32_t i = 0; i < m_Indices.size(); ++i) {
+      m_Indices[i] = i;
+    }
+    if (boxes.empty()) {
+      return;
+    }
+    m_Nodes.reserve(2 * boxes.size() / maxLeafSize + 1);
+    m_Nodes.emplace_back();
+    subdivide(boxes, 0, 0, uint32_t(boxes.size()));
+  }
+
+  bool empty() const { return m_Nodes.empty(); }
+
+  // Number of primitives referenced by the tree
+  size_t size() const { return m_Indices.size(); }
+
+  // Index of the primitive (in the array given to build()) stored at slot i,
+  // leaves cover the slots [first, first + count)
+  uint32_t primitive(uint32_t slot) const { return m_Indices[slot]; }
+
+  // Calls visit(first, count) for every leaf whose bounds contain p, until
+  // visit returns true. Returns true if the query was stopped.
+  template <typename Visitor>
+  bool queryPointLeaves(const glm::vec3 &p, Visitor &&visit) const
+  {
+    if (empty()) {
+      return false;
+    }
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize) {
+      const auto &node = m_Nodes[stack[--stackSize]];
+      if (!node.bounds.contains(p)) {
+        continue;
+      }
+      if (node.count) {
+        if (visit(node.first, node.count)) {
+          return true;
+        }
+      } else {
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = node.first + 1;
+      }
+    }
+    return false;
+  }
+
+  // Calls visit(primitiveIndex) for every primitive of the leaves containing
+  // p, until visit returns true. Returns true if the query was stopped.
+  template <typename Visitor>
+  bool queryPoint(const glm::vec3 &p, Visitor &&visit) const
+  {
+    return queryPointLeaves(p, [&](uint32_t first, uint32_t count) {
+      for (uint32_t i = first; i < first + count; ++i) {
+        if (visit(m_Indices[i])) {
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
+  // Visits front to back the primitives whose box is crossed by the ray
+  // origin + t * direction, t in [0, tMax]. visit(primitiveIndex, tMax) may
+  // shrink tMax (e.g. to the closest hit found so far) to prune the rest of
+  // the traversal.
+  template <typename Visitor>
+  void queryRay(const glm::vec3 &origin, const glm::vec3 &direction,
+      float tMax, Visitor &&visit) const
+  {
+    queryRay(origin, direction, tMax, 0.f, std::forward<Visitor>(visit));
+  }
+
+  // Same as above with every box grown by inflate, which turns the ray into a
+  // sphere of radius inflate swept along it (conservative at edges/corners)
+  template <typename Visitor>
+  void queryRay(const glm::vec3 &origin, const glm::vec3 &direction,
+      float tMax, float inflate, Visitor &&visit) const
+  {
+    if (empty()) {
+      return;
+    }
+    const auto invDir = 1.f / direction;
+    float tEnter, tExit;
+    if (!m_Nodes[0].bounds.inflated(inflate).intersectRay(
+            origin, invDir, tMax, tEnter, tExit)) {
+      return;
+    }
+    struct Entry
+    {
+      uint32_t node;
+      float tEnter;
+    };
+    Entry stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0, tEnter};
+    while (stackSize) {
+      const auto entry = stack[--stackSize];
+      if (entry.tEnter > tMax) {
+        continue;
+      }
+      const auto &node = m_Nodes[entry.node];
+      if (node.count) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+          visit(m_Indices[i], tMax);
+        }
+        continue;
+      }
+      float tLeft, tRight;
+      const bool hitLeft =
+          m_Nodes[node.first].bounds.inflated(inflate).intersectRay(
+              origin, invDir, tMax, tLeft, tExit);
+      const bool hitRight =
+          m_Nodes[node.first + 1].bounds.inflated(inflate).intersectRay(
+              origin, invDir, tMax, tRight, tExit);
+      // Push the farthest child first so that the nearest is visited first
+      if (hitLeft && hitRight) {
+        if (tLeft <= tRight) {
+          stack[stackSize++] = {node.first + 1, tRight};
+          stack[stackSize++] = {node.first, tLeft};
+        } else {
+          stack[stackSize++] = {node.first, tLeft};
+          stack[stackSize++] = {node.first + 1, tRight};
+        }
+      } else if (hitLeft) {
+        stack[stackSize++] = {node.first, tLeft};
+      } else if (hitRight) {
+        stack[stackSize++] = {node.first + 1, tRight};
+      }
+    }
+  }
+
+  // Same as queryRay on the segment [start, end], t in [0, 1]
+  template <typename Visitor>
+  void querySegment(
+      const glm::vec3 &start, const glm::vec3 &end, Visitor &&visit) const
+  {
+    queryRay(start, end - start, 1.f, std::forward<Visitor>(visit));
+  }
+
+private:
+  struct Node
+  {
+    Aabb bounds;
+    uint32_t first; // First child node if count == 0, else first slot
+    uint32_t count; // Number of primitives, 0 for inner nodes
+  };
+
+  // Median split along the longest axis of the centroids bounds
+  void subdivide(const std::vector<Aabb> &boxes, uint32_t nodeIdx,
+      uint32_t begin, uint32_t end)
+  {
+    Aabb bounds, centroids;
+    for (uint32_t i = begin; i < end; ++i) {
+      bounds.grow(boxes[m_Indices[i]]);
+      centroids.grow(boxes[m_Indices[i]].center());
+    }
+    m_Nodes[nodeIdx].bounds = bounds;
+
+    const auto extent = centroids.max - centroids.min;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                         : (extent.y > extent.z ? 1 : 2);
+    if (end - begin <= maxLeafSize || extent[axis] <= 0.f) {
+      m_Nodes[nodeIdx].first = begin;
+      m_Nodes[nodeIdx].count = end - begin;
+      return;
+    }
+
+    const auto mid = begin + (end - begin) / 2;
+    std::nth_element(m_Indices.begin() + begin, m_Indices.begin() + mid,
+        m_Indices.begin() + end, [&](uint32_t lhs, uint32_t rhs) {
+          return boxes[lhs].center()[axis] < boxes[rhs].center()[axis];
+        });
+
+    const auto leftIdx = uint32_t(m_Nodes.size());
+    m_Nodes[nodeIdx].first = leftIdx;
+    m_Nodes[nodeIdx].count = 0;
+    m_Nodes.emplace_back();
+    m_Nodes.emplace_back();
+    subdivide(boxes, leftIdx, begin, mid);
+    subdivide(boxes, leftIdx + 1, mid, end);
+  }
+
+  std::vector<Node> m_Nodes;
+  std::vector<uint32_t> m_Indices;
+};
+} // namespace kln
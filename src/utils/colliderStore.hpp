@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <glm/vec3.hpp>
+#include <klein/klein.hpp>
+#include <new>
+#include <vector>
+
+namespace kln
+{
+// Minimal allocator returning memory aligned on Alignment bytes, so that the
+// collider buffers start on a cache line and SIMD loads never split one
+template <typename T, std::size_t Alignment> struct AlignedAllocator
+{
+  using value_type = T;
+
+  template <typename U> struct rebind
+  {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+  {
+  }
+
+  T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T *p, std::size_t)
+  {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const
+  {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment> &) const
+  {
+    return false;
+  }
+};
+
+// Packed planes of every collider, precomputed once. Each of the six plane
+// slots is stored as four structure-of-arrays buffers (x, y, z, d) indexed by
+// collider, padded with planes rejecting every point so that a kernel reading
+// `lanes` colliders from any index below size() stays in bounds.
+// A point p is inside collider i when x * p.x + y * p.y + z * p.z + d > 0 for
+// all its planes, which is Transformation::collidesWith without the meet.
+class ColliderStore
+{
+public:
+  static constexpr std::size_t planeCount = 6;
+  static constexpr std::size_t alignment = 64;
+  static constexpr std::size_t lanes = 16; // Widest kernel (AVX-512)
+
+  void clear()
+  {
+    for (auto &buffer : m_Planes) {
+      buffer.clear();
+    }
+    m_Size = 0;
+  }
+
+  void reserve(std::size_t count)
+  {
+    for (auto &buffer : m_Planes) {
+      buffer.reserve(paddedSize(count));
+    }
+  }
+
+  void push_back(const std::array<plane, planeCount> &planes)
+  {
+    const auto padded = paddedSize(m_Size + 1);
+    if (padded != m_Planes[0].size()) {
+      for (std::size_t k = 0; k < planeCount; ++k) {
+        // 0 * p - 1 is never > 0: padding never contains anything
+        m_Planes[4 * k + 0].resize(padded, 0.f);
+        m_Planes[4 * k + 1].resize(padded, 0.f);
+        m_Planes[4 * k + 2].resize(padded, 0.f);
+        m_Planes[4 * k + 3].resize(padded, -1.f);
+      }
+    }
+    for (std::size_t k = 0; k < planeCount; ++k) {
+      m_Planes[4 * k + 0][m_Size] = planes[k].x();
+      m_Planes[4 * k + 1][m_Size] = planes[k].y();
+      m_Planes[4 * k + 2][m_Size] = planes[k].z();
+      m_Planes[4 * k + 3][m_Size] = planes[k].d();
+    }
+    ++m_Size;
+  }
+
+  std::size_t size() const { return m_Size; }
+
+  bool contains(std::size_t idx, const glm::vec3 &p) const
+  {
+    for (std::size_t k = 0; k < planeCount; ++k) {
+      if (distance(k, idx, p) <= 0.f) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // True if any collider in [begin, end) contains p
+  bool containsAny(std::size_t begin, std::size_t end, const glm::vec3 &p) const
+  {
+    for (auto idx = begin; idx < end; ++idx) {
+      if (contains(idx, p)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Raw access to the buffers, plane k of collider i is
+  // (x(k)[i], y(k)[i], z(k)[i], d(k)[i])
+  const float *x(std::size_t k) const { return m_Planes[4 * k + 0].data(); }
+  const float *y(std::size_t k) const { return m_Planes[4 * k + 1].data(); }
+  const float *z(std::size_t k) const { return m_Planes[4 * k + 2].data(); }
+  const float *d(std::size_t k) const { return m_Planes[4 * k + 3].data(); }
+
+private:
+  using FloatBuffer = std::vector<float, AlignedAllocator<float, alignment>>;
+
+  static std::size_t paddedSize(std::size_t count)
+  {
+    return (count + 2 * lanes - 2) / lanes * lanes;
+  }
+
+  float distance(std::size_t k, std::size_t idx, const glm::vec3 &p) const
+  {
+    return x(k)[idx] * p.x + y(k)[idx] * p.y + z(k)[idx] * p.z + d(k)[idx];
+  }
+
+  std::array<FloatBuffer, 4 * planeCount> m_Planes;
+  std::size_t m_Size = 0;
+};
+} // namespace kln
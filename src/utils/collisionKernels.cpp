@@ -0,0 +1,233 @@
+#include "collisionKernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#define COLLISION_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// The project is compiled for SSE3 (see klein), wider kernels are compiled
+// for their own instruction set and only called after a runtime check
+#if defined(__GNUC__) || defined(__clang__)
+#define COLLISION_TARGET(isa) __attribute__((target(isa)))
+#else
+#define COLLISION_TARGET(isa)
+#endif
+
+namespace kln
+{
+namespace
+{
+constexpr auto planeCount = ColliderStore::planeCount;
+
+bool containsAnyScalar(const ColliderStore &store, std::size_t begin,
+    std::size_t end, const glm::vec3 &p)
+{
+  return store.containsAny(begin, end, p);
+}
+
+#ifdef COLLISION_X86
+// Bits of the lanes in [i, end) for a kernel processing `width` colliders
+int laneMask(std::size_t remaining, std::size_t width)
+{
+  return remaining >= width ? (1 << width) - 1 : (1 << remaining) - 1;
+}
+
+// Planes are evaluated in the same order as ColliderStore::contains, so that
+// every kernel returns exactly the same results as the scalar one. This file
+// is built without floating-point contraction (see CMakeLists.txt), otherwise
+// the AVX-512 target, which implies FMA, fuses the multiply-adds.
+COLLISION_TARGET("sse4.1")
+bool containsAnySse41(const ColliderStore &store, std::size_t begin,
+    std::size_t end, const glm::vec3 &p)
+{
+  const __m128 px = _mm_set1_ps(p.x);
+  const __m128 py = _mm_set1_ps(p.y);
+  const __m128 pz = _mm_set1_ps(p.z);
+  const __m128 zero = _mm_setzero_ps();
+  for (auto i = begin; i < end; i += 4) {
+    __m128i inside = _mm_set1_epi32(-1);
+    for (std::size_t k = 0; k < planeCount; ++k) {
+      const __m128 dist = _mm_add_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(store.x(k) + i), px),
+                         _mm_mul_ps(_mm_loadu_ps(store.y(k) + i), py)),
+              _mm_mul_ps(_mm_loadu_ps(store.z(k) + i), pz)),
+          _mm_loadu_ps(store.d(k) + i));
+      inside =
+          _mm_and_si128(inside, _mm_castps_si128(_mm_cmpgt_ps(dist, zero)));
+      if (_mm_testz_si128(inside, inside)) {
+        break; // Every lane is already outside
+      }
+    }
+    if (_mm_movemask_ps(_mm_castsi128_ps(inside)) & laneMask(end - i, 4)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+COLLISION_TARGET("avx2")
+bool containsAnyAvx2(const ColliderStore &store, std::size_t begin,
+    std::size_t end, const glm::vec3 &p)
+{
+  const __m256 px = _mm256_set1_ps(p.x);
+  const __m256 py = _mm256_set1_ps(p.y);
+  const __m256 pz = _mm256_set1_ps(p.z);
+  const __m256 zero = _mm256_setzero_ps();
+  for (auto i = begin; i < end; i += 8) {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (std::size_t k = 0; k < planeCount; ++k) {
+      const __m256 dist = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(store.x(k) + i), px),
+                  _mm256_mul_ps(_mm256_loadu_ps(store.y(k) + i), py)),
+              _mm256_mul_ps(_mm256_loadu_ps(store.z(k) + i), pz)),
+          _mm256_loadu_ps(store.d(k) + i));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, zero, _CMP_GT_OQ));
+      if (_mm256_testz_ps(inside, inside)) {
+        break;
+      }
+    }
+    if (_mm256_movemask_ps(inside) & laneMask(end - i, 8)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+COLLISION_TARGET("avx512f")
+bool containsAnyAvx512(const ColliderStore &store, std::size_t begin,
+    std::size_t end, const glm::vec3 &p)
+{
+  const __m512 px = _mm512_set1_ps(p.x);
+  const __m512 py = _mm512_set1_ps(p.y);
+  const __m512 pz = _mm512_set1_ps(p.z);
+  const __m512 zero = _mm512_setzero_ps();
+  for (auto i = begin; i < end; i += 16) {
+    __mmask16 inside = __mmask16(laneMask(end - i, 16));
+    for (std::size_t k = 0; k < planeCount && inside; ++k) {
+      const __m512 dist = _mm512_add_ps(
+          _mm512_add_ps(
+              _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(store.x(k) + i), px),
+                  _mm512_mul_ps(_mm512_loadu_ps(store.y(k) + i), py)),
+              _mm512_mul_ps(_mm512_loadu_ps(store.z(k) + i), pz)),
+          _mm512_loadu_ps(store.d(k) + i));
+      inside = _mm512_mask_cmp_ps_mask(inside, dist, zero, _CMP_GT_OQ);
+    }
+    if (inside) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool cpuSupports(SimdLevel level)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  switch (level) {
+  case SimdLevel::Scalar:
+    return true;
+  case SimdLevel::Sse41:
+    return __builtin_cpu_supports("sse4.1");
+  case SimdLevel::Avx2:
+    return __builtin_cpu_supports("avx2");
+  case SimdLevel::Avx512:
+    return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  const bool sse41 = info[2] & (1 << 19);
+  const bool osxsave = info[2] & (1 << 27);
+  const bool avx = info[2] & (1 << 28);
+  const auto xcr0 = osxsave ? _xgetbv(0) : 0;
+  __cpuidex(info, 7, 0);
+  const bool avx2 = avx && (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5));
+  const bool avx512 = avx2 && (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16));
+  switch (level) {
+  case SimdLevel::Scalar:
+    return true;
+  case SimdLevel::Sse41:
+    return sse41;
+  case SimdLevel::Avx2:
+    return avx2;
+  case SimdLevel::Avx512:
+    return avx512;
+  }
+  return false;
+#else
+  return level == SimdLevel::Scalar;
+#endif
+}
+#else
+bool cpuSupports(SimdLevel level) { return level == SimdLevel::Scalar; }
+#endif
+} // namespace
+
+SimdLevel detectSimdLevel()
+{
+  static const auto level = []() {
+    for (auto level : {SimdLevel::Avx512, SimdLevel::Avx2, SimdLevel::Sse41}) {
+      if (cpuSupports(level)) {
+        return level;
+      }
+    }
+    return SimdLevel::Scalar;
+  }();
+  return level;
+}
+
+const char *getSimdLevelName(SimdLevel level)
+{
+  switch (level) {
+  case SimdLevel::Scalar:
+    return "scalar";
+  case SimdLevel::Sse41:
+    return "SSE4.1";
+  case SimdLevel::Avx2:
+    return "AVX2";
+  case SimdLevel::Avx512:
+    return "AVX-512";
+  }
+  return "unknown";
+}
+
+ContainsAnyKernel getContainsAnyKernel(SimdLevel level)
+{
+  if (level > detectSimdLevel()) {
+    level = detectSimdLevel();
+  }
+  switch (level) {
+#ifdef COLLISION_X86
+  case SimdLevel::Avx512:
+    return containsAnyAvx512;
+  case SimdLevel::Avx2:
+    return containsAnyAvx2;
+  case SimdLevel::Sse41:
+    return containsAnySse41;
+#endif
+  default:
+    return containsAnyScalar;
+  }
+}
+
+ContainsAnyKernel getContainsAnyKernel()
+{
+  static const auto kernel = getContainsAnyKernel(detectSimdLevel());
+  return kernel;
+}
+
+void containsAnyBatch(const ColliderStore &store, const glm::vec3 *points,
+    std::size_t count, bool *results)
+{
+  const auto containsAny = getContainsAnyKernel();
+  for (std::size_t i = 0; i < count; ++i) {
+    results[i] = containsAny(store, 0, store.size(), points[i]);
+  }
+}
+} // namespace kln
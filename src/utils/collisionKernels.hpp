@@ -0,0 +1,39 @@
+#pragma once
+
+#include "colliderStore.hpp"
+
+#include <cstddef>
+#include <glm/vec3.hpp>
+
+namespace kln
+{
+// Instruction sets of the containment kernels, from slowest to fastest
+enum class SimdLevel
+{
+  Scalar,
+  Sse41,  // 4 colliders per iteration
+  Avx2,   // 8 colliders per iteration
+  Avx512, // 16 colliders per iteration
+};
+
+// Returns true if any collider of store in [begin, end) contains p
+using ContainsAnyKernel = bool (*)(
+    const ColliderStore &store, std::size_t begin, std::size_t end,
+    const glm::vec3 &p);
+
+// Best level supported by the running CPU (and OS, for the AVX states)
+SimdLevel detectSimdLevel();
+
+const char *getSimdLevelName(SimdLevel level);
+
+// Kernel for a given level, falling back to the best supported level below it
+ContainsAnyKernel getContainsAnyKernel(SimdLevel level);
+
+// Kernel for detectSimdLevel(), resolved once
+ContainsAnyKernel getContainsAnyKernel();
+
+// Tests count points against every collider of the store with the kernel of
+// detectSimdLevel(), for stores small enough to skip the BVH
+void containsAnyBatch(const ColliderStore &store, const glm::vec3 *points,
+    std::size_t count, bool *results);
+} // namespace kln
@@ -1,96 +1,79 @@
 #pragma once
 
 #include "bbox.hpp"
+#include "frustum.hpp"
+#include "geometryRegistry.hpp"
 #include "glad/glad.h"
-#include "uniformHandler.hpp"
+#include "packedVertex.hpp"
+#include "streamBuffer.hpp"
+#include "uniformBuffers.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <array>
 #include <iostream>
 #include <vector>
 
 // Represents a single vertex of a cube
-struct CubeVertex
-{
-
-  CubeVertex(
-      const glm::vec3 &pos, const glm::vec3 &norm, const glm::vec2 &tex) :
-      position{pos}, normal{norm}, texCoords{tex}
-  {
-  }
-
-  static unsigned long sizeOfVertex()
-  {
-    return sizeof(position) + sizeof(normal) + sizeof(texCoords);
-  }
-
-  glm::vec3 position;  // Vertex position
-  glm::vec3 normal;    // Normal vector
-  glm::vec2 texCoords; // Texture coordinates
-};
+using CubeVertex = PackedVertex;
 
+// Indexed cube: 4 vertices per face, so that faces keep their own normals
+// and texture coordinates, and 36 indices. The mesh lives in a
+// GeometryRegistry, shared with every cube of the same size.
 class CubeCustom
 {
 public:
-  // Constructor for the skybox only
-  CubeCustom(GLfloat width, GLfloat height, GLfloat depth) :
-      m_nVertexCount(0), positions{}
+  CubeCustom(GeometryRegistry &geometry, GLfloat width, GLfloat height,
+      GLfloat depth) :
+      m_Geometry{geometry},
+      m_Mesh{addGeometry(geometry, width, height, depth)},
+      m_HalfExtents{width / 2.f, height / 2.f, depth / 2.f}, positions{}
   {
-    build(width, height, depth); // Build method (implementation in the .cpp)
-    initObj(0, 1, 2);
   }
 
-  // Returns a pointer to the data
-  const CubeVertex *getDataPointer() const { return &m_Vertices[0]; }
-
-  // Returns the number of vertices
-  GLsizei getVertexCount() const { return m_nVertexCount; }
-
-  const unsigned long getVertexSize() const
+  // Adds the mesh of a cube to geometry, or finds the one already there
+  static GeometryHandle addGeometry(
+      GeometryRegistry &geometry, GLfloat width, GLfloat height, GLfloat depth)
   {
-    return CubeVertex::sizeOfVertex();
+    const auto vertices = build(width, height, depth);
+    // Two triangles per face: bottom-left, bottom-right, top-right and
+    // bottom-left, top-right, top-left
+    const uint16_t faceCorners[] = {0, 1, 2, 0, 2, 3};
+    uint16_t indices[36];
+    for (uint16_t i = 0; i < 36; ++i) {
+      indices[i] = uint16_t(4 * (i / 6) + faceCorners[i % 6]);
+    }
+    return geometry.add(vertices.data(), GLsizei(vertices.size()), indices, 36);
   }
 
-  void initObj(GLuint vPos, GLuint vNorm, GLuint vTex)
-  {
-    initVboPointer();
-    initVaoPointer(vPos, vNorm, vTex); // potential error here ^^
-  }
+  // In instanced mode every position is drawn by a single instanced call,
+  // positions being read from a per-instance attribute (aInstanceOffset)
+  void setInstanced(bool instanced) { m_Instanced = instanced; }
 
-  void draw(const glm::mat4 &modelMatrix, const glm::mat4 &viewMatrix,
-      const glm::mat4 &projMatrix, GLuint modelViewProjMatrixLocation) const
-  {
-    const auto mvMatrix = viewMatrix * modelMatrix;
-    const auto mvpMatrix = projMatrix * mvMatrix;
-    glUniformMatrix4fv(
-        modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, getVertexCount());
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-  }
+  bool isInstanced() const { return m_Instanced; }
 
-  void draw(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
-      UniformHandler handler) const
+  // Cubes outside of frustum (if given) are skipped. Each cube gets a slot in
+  // objects on its first draw, so a cube is always drawn with the same buffer
+  void draw(GLStateCache &state, ObjectUniformBuffer &objects,
+      Frustum *frustum = nullptr)
   {
-    for (const auto &position : positions) {
-      const auto mvMatrix =
-          viewMatrix * glm::translate(glm::mat4(1.f), position);
-      const auto mvpMatrix = projMatrix * mvMatrix;
-      const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-      glUniformMatrix4fv(
-          handler.uModelViewProjMatrix, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-      glUniformMatrix4fv(
-          handler.uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-      glUniformMatrix4fv(
-          handler.uNormalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-      glBindBuffer(GL_ARRAY_BUFFER, vbo);
-      glBindVertexArray(vao);
-      glDrawArrays(GL_TRIANGLES, 0, getVertexCount());
-      glBindVertexArray(0);
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (m_Instanced) {
+      drawInstanced(state, objects, frustum);
+      return;
+    }
+    while (m_ObjectSlots.size() < positions.size()) {
+      const auto &position = positions[m_ObjectSlots.size()];
+      m_ObjectSlots.push_back(
+          objects.add(glm::translate(glm::mat4(1.f), position)));
+    }
+    m_Geometry.bind(state);
+    for (size_t i = 0; i < positions.size(); ++i) {
+      if (frustum && !frustum->isVisible(getBounds(positions[i]))) {
+        continue;
+      }
+      objects.bind(m_ObjectSlots[i]);
+      m_Geometry.draw(m_Mesh);
     }
   }
 
@@ -98,6 +81,7 @@ public:
   {
     positions.push_back(position);
     bbox.add({kln::point(position.x, position.y, position.z)});
+    m_InstancesDirty = true;
   }
 
   void add(const std::vector<glm::vec3> &_positions, kln::Bbox &bbox)
@@ -106,44 +90,66 @@ public:
       positions.push_back(position);
       bbox.add({kln::point(position.x, position.y, position.z)});
     }
+    m_InstancesDirty = true;
   }
 
-private:
-  // Initializes VAO pointers for position, normal, and texture coordinates
-  void initVaoPointer(GLuint vPos, GLuint vNorm, GLuint vTex)
+  kln::Aabb getBounds(const glm::vec3 &position) const
   {
-    std::cout << "quad vao init" << std::endl;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glEnableVertexAttribArray(vPos);
-    glEnableVertexAttribArray(vNorm);
-    glEnableVertexAttribArray(vTex);
-    glVertexAttribPointer(vPos, 3, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(CubeVertex, position));
-    glVertexAttribPointer(vNorm, 3, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(CubeVertex, normal));
-    glVertexAttribPointer(vTex, 2, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(CubeVertex, texCoords));
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return {position - m_HalfExtents, position + m_HalfExtents};
   }
 
-  void initVboPointer()
+private:
+  void drawInstanced(
+      GLStateCache &state, ObjectUniformBuffer &objects, Frustum *frustum)
   {
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, getVertexCount() * getVertexSize(),
-        getDataPointer(), GL_STATIC_DRAW);
+    if (!m_InstanceVbo) {
+      glGenBuffers(1, &m_InstanceVbo);
+    }
+    // With culling, the visible cubes of the frame are streamed, otherwise
+    // the instance buffer holds every cube and is only refilled after an add()
+    const std::vector<glm::vec3> *instances = &positions;
+    GLuint instanceBuffer = m_InstanceVbo;
+    GLintptr instanceOffset = 0;
+    if (frustum) {
+      m_VisibleOffsets.clear();
+      for (const auto &position : positions) {
+        if (frustum->isVisible(getBounds(position))) {
+          m_VisibleOffsets.push_back(position);
+        }
+      }
+      instances = &m_VisibleOffsets;
+    }
+    if (instances->empty()) {
+      return;
+    }
+    if (frustum) {
+      instanceOffset = m_InstanceStream.upload(m_VisibleOffsets.data(),
+          m_VisibleOffsets.size() * sizeof(glm::vec3), sizeof(glm::vec3),
+          &state);
+      instanceBuffer = m_InstanceStream.getBuffer();
+    } else if (m_InstancesDirty) {
+      state.bindBuffer(GL_ARRAY_BUFFER, m_InstanceVbo);
+      glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3),
+          positions.data(), GL_STATIC_DRAW);
+      m_InstancesDirty = false;
+    }
+    // Translations don't change the normal matrix, so every instance shares
+    // the identity model matrix and only adds its offset to the positions
+    objects.bind(ObjectUniformBuffer::identitySlot);
+    m_Geometry.bindInstanced(state, instanceBuffer, instanceOffset);
+    m_Geometry.drawInstanced(m_Mesh, GLsizei(instances->size()));
   }
+
   // Builds the cube data
-  void build(GLfloat width, GLfloat height, GLfloat depth)
+  static std::array<CubeVertex, 24> build(
+      GLfloat width, GLfloat height, GLfloat depth)
   {
     GLfloat halfWidth = width / 2.f;
     GLfloat halfHeight = height / 2.f;
     GLfloat halfDepth = depth / 2.f;
 
-    // Define the vertices for a cube (12 triangles forming 6 rectangle faces)
-    CubeVertex vertices[] = {
+    // Define the vertices for a cube (6 rectangle faces of 4 vertices)
+    return {{
         // Front face
         {{-halfWidth, -halfHeight, halfDepth}, {0.f, 0.f, 1.f},
             {0.f, 0.f}}, // Bottom-left
@@ -151,11 +157,6 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{halfWidth, halfHeight, halfDepth}, {0.f, 0.f, 1.f},
             {1.f, 1.f}}, // Top-right
-
-        {{-halfWidth, -halfHeight, halfDepth}, {0.f, 0.f, 1.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{halfWidth, halfHeight, halfDepth}, {0.f, 0.f, 1.f},
-            {1.f, 1.f}}, // Top-right
         {{-halfWidth, halfHeight, halfDepth}, {0.f, 0.f, 1.f},
             {0.f, 1.f}}, // Top-left
 
@@ -166,11 +167,6 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{-halfWidth, halfHeight, -halfDepth}, {0.f, 0.f, -1.f},
             {1.f, 1.f}}, // Top-right
-
-        {{halfWidth, -halfHeight, -halfDepth}, {0.f, 0.f, -1.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{-halfWidth, halfHeight, -halfDepth}, {0.f, 0.f, -1.f},
-            {1.f, 1.f}}, // Top-right
         {{halfWidth, halfHeight, -halfDepth}, {0.f, 0.f, -1.f},
             {0.f, 1.f}}, // Top-left
 
@@ -181,11 +177,6 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{-halfWidth, halfHeight, halfDepth}, {-1.f, 0.f, 0.f},
             {1.f, 1.f}}, // Top-right
-
-        {{-halfWidth, -halfHeight, -halfDepth}, {-1.f, 0.f, 0.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{-halfWidth, halfHeight, halfDepth}, {-1.f, 0.f, 0.f},
-            {1.f, 1.f}}, // Top-right
         {{-halfWidth, halfHeight, -halfDepth}, {-1.f, 0.f, 0.f},
             {0.f, 1.f}}, // Top-left
 
@@ -196,11 +187,6 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{halfWidth, halfHeight, -halfDepth}, {1.f, 0.f, 0.f},
             {1.f, 1.f}}, // Top-right
-
-        {{halfWidth, -halfHeight, halfDepth}, {1.f, 0.f, 0.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{halfWidth, halfHeight, -halfDepth}, {1.f, 0.f, 0.f},
-            {1.f, 1.f}}, // Top-right
         {{halfWidth, halfHeight, halfDepth}, {1.f, 0.f, 0.f},
             {0.f, 1.f}}, // Top-left
 
@@ -211,11 +197,6 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{halfWidth, halfHeight, -halfDepth}, {0.f, 1.f, 0.f},
             {1.f, 1.f}}, // Top-right
-
-        {{-halfWidth, halfHeight, halfDepth}, {0.f, 1.f, 0.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{halfWidth, halfHeight, -halfDepth}, {0.f, 1.f, 0.f},
-            {1.f, 1.f}}, // Top-right
         {{-halfWidth, halfHeight, -halfDepth}, {0.f, 1.f, 0.f},
             {0.f, 1.f}}, // Top-left
 
@@ -226,23 +207,19 @@ private:
             {1.f, 0.f}}, // Bottom-right
         {{halfWidth, -halfHeight, halfDepth}, {0.f, -1.f, 0.f},
             {1.f, 1.f}}, // Top-right
-
-        {{-halfWidth, -halfHeight, -halfDepth}, {0.f, -1.f, 0.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{halfWidth, -halfHeight, halfDepth}, {0.f, -1.f, 0.f},
-            {1.f, 1.f}}, // Top-right
         {{-halfWidth, -halfHeight, halfDepth}, {0.f, -1.f, 0.f},
             {0.f, 1.f}} // Top-left
-    };
-
-    m_Vertices.assign(
-        vertices, vertices + 36); // Add all vertices to the vector
-    m_nVertexCount =
-        36; // Six faces * 2 triangles per face * 3 vertices per triangle
+    }};
   }
 
-  std::vector<CubeVertex> m_Vertices;
-  GLsizei m_nVertexCount; // Number of vertices
-  GLuint vao, vbo;
+  GeometryRegistry &m_Geometry;
+  GeometryHandle m_Mesh;
+  glm::vec3 m_HalfExtents;
   std::vector<glm::vec3> positions;
+  std::vector<uint32_t> m_ObjectSlots; // Slot of each position
+  std::vector<glm::vec3> m_VisibleOffsets; // Reused by every culled draw
+  bool m_Instanced = true;
+  bool m_InstancesDirty = true;
+  GLuint m_InstanceVbo = 0;
+  StreamBuffer m_InstanceStream;
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+
+// Runs a simulation at a fixed tick rate, independently of the frame rate.
+// Elapsed frame time is accumulated and consumed in steps of getDeltaTime();
+// what is left over gives the interpolation factor between the last two
+// simulated states, so rendering can run faster than the simulation.
+class FixedTimestep
+{
+public:
+  FixedTimestep(float tickRate = 60.f, int maxStepsPerFrame = 8) :
+      m_MaxStepsPerFrame{maxStepsPerFrame}
+  {
+    setTickRate(tickRate);
+  }
+
+  void setTickRate(float tickRate)
+  {
+    m_TickRate = std::max(tickRate, 1.f);
+    m_DeltaTime = 1.f / m_TickRate;
+  }
+
+  float getTickRate() const { return m_TickRate; }
+
+  // Duration of one simulation step in seconds
+  float getDeltaTime() const { return m_DeltaTime; }
+
+  // Adds frameTime seconds and calls step() once per elapsed tick. Returns
+  // the number of steps taken. Ticks beyond maxStepsPerFrame are dropped so
+  // that a slow frame can't trigger ever longer catch-ups.
+  template <typename Step> int advance(double frameTime, Step &&step)
+  {
+    m_Accumulator += std::max(frameTime, 0.);
+    int steps = 0;
+    while (m_Accumulator >= m_DeltaTime) {
+      if (steps == m_MaxStepsPerFrame) {
+        m_Accumulator = 0.;
+        break;
+      }
+      step();
+      m_Accumulator -= m_DeltaTime;
+      ++steps;
+    }
+    return steps;
+  }
+
+  // Fraction of a tick elapsed since the last step, in [0, 1), to blend the
+  // previous and current simulation states when rendering
+  float getAlpha() const { return float(m_Accumulator / m_DeltaTime); }
+
+private:
+  float m_TickRate;
+  float m_DeltaTime;
+  int m_MaxStepsPerFrame;
+  double m_Accumulator = 0.;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "bvh.hpp"
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <klein/klein.hpp>
+
+// View frustum of a camera as six kln::plane, the same representation as the
+// collision boxes (see kln::Transformation::getPlanes): a point p is inside
+// when x * p.x + y * p.y + z * p.z + d >= 0 for every plane.
+// Every visibility test is counted so that the number of culled and visible
+// objects of the frame can be displayed.
+class Frustum
+{
+public:
+  enum Side
+  {
+    Left,
+    Right,
+    Bottom,
+    Top,
+    Near,
+    Far
+  };
+
+  Frustum() = default;
+
+  explicit Frustum(const glm::mat4 &viewProjMatrix) { update(viewProjMatrix); }
+
+  // Extracts the planes from projMatrix * viewMatrix (Gribb & Hartmann) and
+  // resets the statistics
+  void update(const glm::mat4 &viewProjMatrix)
+  {
+    const auto row = [&](int i) {
+      return glm::vec4(viewProjMatrix[0][i], viewProjMatrix[1][i],
+          viewProjMatrix[2][i], viewProjMatrix[3][i]);
+    };
+    const glm::vec4 equations[6] = {row(3) + row(0), row(3) - row(0),
+        row(3) + row(1), row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+    for (int i = 0; i < 6; ++i) {
+      // kln::plane::normalize() leaves d untouched, so the whole equation is
+      // scaled here to keep d a distance
+      const auto e = equations[i] / glm::length(glm::vec3(equations[i]));
+      m_Planes[i] = kln::plane(e.x, e.y, e.z, e.w);
+    }
+    m_Visible = 0;
+    m_Culled = 0;
+  }
+
+  const std::array<kln::plane, 6> &getPlanes() const { return m_Planes; }
+
+  // Conservative box test: the box is culled only if it is entirely on the
+  // outer side of one plane
+  bool isVisible(const kln::Aabb &box)
+  {
+    for (const auto &plane : m_Planes) {
+      // Corner of the box the farthest along the plane normal
+      const glm::vec3 corner{plane.x() >= 0.f ? box.max.x : box.min.x,
+          plane.y() >= 0.f ? box.max.y : box.min.y,
+          plane.z() >= 0.f ? box.max.z : box.min.z};
+      if (plane.x() * corner.x + plane.y() * corner.y +
+              plane.z() * corner.z + plane.d() <
+          0.f) {
+        ++m_Culled;
+        return false;
+      }
+    }
+    ++m_Visible;
+    return true;
+  }
+
+  // Local box of an object (e.g. a glTF mesh) placed by modelMatrix
+  bool isVisible(const kln::Aabb &localBox, const glm::mat4 &modelMatrix)
+  {
+    return isVisible(transformBox(localBox, modelMatrix));
+  }
+
+  // World space bounds of a transformed box (Arvo's method)
+  static kln::Aabb transformBox(const kln::Aabb &box, const glm::mat4 &matrix)
+  {
+    kln::Aabb result;
+    result.min = result.max = glm::vec3(matrix[3]);
+    for (int i = 0; i < 3; ++i) {
+      const auto a = glm::vec3(matrix[i]) * box.min[i];
+      const auto b = glm::vec3(matrix[i]) * box.max[i];
+      result.min += glm::min(a, b);
+      result.max += glm::max(a, b);
+    }
+    return result;
+  }
+
+  uint32_t getVisibleCount() const { return m_Visible; }
+
+  uint32_t getCulledCount() const { return m_Culled; }
+
+private:
+  std::array<kln::plane, 6> m_Planes;
+  uint32_t m_Visible = 0;
+  uint32_t m_Culled = 0;
+};
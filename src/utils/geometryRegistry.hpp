@@ -0,0 +1,234 @@
+#pragma once
+
+#include "glStateCache.hpp"
+#include "glad/glad.h"
+#include "hash.hpp"
+#include "packedVertex.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Mesh of a GeometryRegistry, a few integers to copy around
+struct GeometryHandle
+{
+  GLint baseVertex = 0;
+  GLuint firstIndex = 0; // In the index buffer of the registry
+  GLsizei indexCount = 0;
+};
+
+// Indexed PackedVertex meshes of the built-in shapes (cubes, quads, skybox),
+// all in one vertex buffer and one index buffer read by one vertex array.
+// Meshes are keyed by the hash of their vertices and indices, so identical
+// shapes are uploaded once, and callers don't keep their vertices once
+// added. A mesh with the same hash is only shared once its counts and its
+// content read back from the buffers match. Buffers grow by doubling, copying
+// their content on the GPU. add() binds buffers and vertex arrays directly,
+// so meshes are added between frames, never during the draws (see
+// GLStateCache).
+class GeometryRegistry
+{
+public:
+  // Per-instance translation of instanced draws, see bindInstanced
+  static constexpr GLuint instanceOffsetLocation = 3;
+
+  GeometryRegistry() = default;
+  GeometryRegistry(const GeometryRegistry &) = delete;
+  GeometryRegistry &operator=(const GeometryRegistry &) = delete;
+
+  // Returns the handle of an identical mesh if there is one, otherwise
+  // uploads the mesh
+  GeometryHandle add(const PackedVertex *vertices, GLsizei vertexCount,
+      const uint16_t *indices, GLsizei indexCount)
+  {
+    const auto verticesSize = GLsizeiptr(vertexCount * sizeof(PackedVertex));
+    const auto indicesSize = GLsizeiptr(indexCount * sizeof(uint16_t));
+    auto key = hashBytes(vertices, verticesSize);
+    key = hashBytes(indices, indicesSize, key);
+    const auto range = m_Meshes.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+      const auto &mesh = it->second;
+      if (mesh.vertexCount == vertexCount &&
+          mesh.handle.indexCount == indexCount &&
+          isStored(mesh.handle, vertices, verticesSize, indices,
+              indicesSize)) {
+        ++m_SharedCount;
+        return mesh.handle;
+      }
+    }
+
+    if (!m_VertexArray) {
+      createVertexArrays();
+    }
+    grow(GL_ARRAY_BUFFER, m_VertexBuffer, m_VertexCapacity,
+        m_VertexSize + verticesSize);
+    grow(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer, m_IndexCapacity,
+        m_IndexSize + indicesSize);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_VertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_VertexSize, verticesSize, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_IndexSize, indicesSize, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    const GeometryHandle handle{GLint(m_VertexSize / sizeof(PackedVertex)),
+        GLuint(m_IndexSize / sizeof(uint16_t)), indexCount};
+    m_VertexSize += verticesSize;
+    m_IndexSize += indicesSize;
+    m_Meshes.emplace(key, Mesh{handle, vertexCount});
+    return handle;
+  }
+
+  // Binds the vertex array shared by every mesh
+  void bind(GLStateCache &state) const
+  {
+    state.bindVertexArray(m_VertexArray);
+  }
+
+  // Same, with instanceOffsetLocation read per instance from 3 floats at
+  // offset in buffer
+  void bindInstanced(
+      GLStateCache &state, GLuint buffer, GLintptr offset) const
+  {
+    state.bindVertexArray(m_InstancedVertexArray);
+    glBindVertexBuffer(
+        instanceOffsetLocation, buffer, offset, 3 * sizeof(GLfloat));
+  }
+
+  // With the vertex array bound
+  void draw(const GeometryHandle &handle) const
+  {
+    glDrawElementsBaseVertex(GL_TRIANGLES, handle.indexCount,
+        GL_UNSIGNED_SHORT, getIndexOffset(handle), handle.baseVertex);
+  }
+
+  void drawInstanced(
+      const GeometryHandle &handle, GLsizei instanceCount) const
+  {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, handle.indexCount,
+        GL_UNSIGNED_SHORT, getIndexOffset(handle), instanceCount,
+        handle.baseVertex);
+  }
+
+  size_t getMeshCount() const { return m_Meshes.size(); }
+
+  // Number of add() calls that found an identical mesh
+  uint32_t getSharedCount() const { return m_SharedCount; }
+
+  GLsizeiptr getSize() const { return m_VertexSize + m_IndexSize; }
+
+  // Not done in a destructor, like StreamBuffer::release
+  void release()
+  {
+    glDeleteVertexArrays(1, &m_VertexArray);
+    glDeleteVertexArrays(1, &m_InstancedVertexArray);
+    glDeleteBuffers(1, &m_VertexBuffer);
+    glDeleteBuffers(1, &m_IndexBuffer);
+    m_VertexArray = m_InstancedVertexArray = 0;
+    m_VertexBuffer = m_IndexBuffer = 0;
+    m_VertexCapacity = m_IndexCapacity = m_VertexSize = m_IndexSize = 0;
+    m_Meshes.clear();
+  }
+
+private:
+  struct Mesh
+  {
+    GeometryHandle handle;
+    GLsizei vertexCount;
+  };
+
+  static const GLvoid *getIndexOffset(const GeometryHandle &handle)
+  {
+    return (const GLvoid *)(uintptr_t(handle.firstIndex) * sizeof(uint16_t));
+  }
+
+  // True if the buffers hold these vertices and indices at handle, read back
+  // as hash collisions are possible. Only done for shapes added again.
+  bool isStored(const GeometryHandle &handle, const PackedVertex *vertices,
+      GLsizeiptr verticesSize, const uint16_t *indices,
+      GLsizeiptr indicesSize) const
+  {
+    std::vector<unsigned char> stored(std::max(verticesSize, indicesSize));
+    glBindBuffer(GL_COPY_READ_BUFFER, m_VertexBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER,
+        GLintptr(handle.baseVertex) * sizeof(PackedVertex), verticesSize,
+        stored.data());
+    auto same = !std::memcmp(stored.data(), vertices, verticesSize);
+    if (same) {
+      glBindBuffer(GL_COPY_READ_BUFFER, m_IndexBuffer);
+      glGetBufferSubData(GL_COPY_READ_BUFFER,
+          GLintptr(handle.firstIndex) * sizeof(uint16_t), indicesSize,
+          stored.data());
+      same = !std::memcmp(stored.data(), indices, indicesSize);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return same;
+  }
+
+  // Attributes 0, 1 and 2 of the forward shaders, read from binding 0
+  void createVertexArrays()
+  {
+    glGenVertexArrays(1, &m_VertexArray);
+    glGenVertexArrays(1, &m_InstancedVertexArray);
+    for (const auto vertexArray : {m_VertexArray, m_InstancedVertexArray}) {
+      glBindVertexArray(vertexArray);
+      PackedVertex::setAttribFormats(0, 1, 2, 0);
+    }
+    // The instance buffer has its own binding, set by bindInstanced
+    glEnableVertexAttribArray(instanceOffsetLocation);
+    glVertexAttribFormat(instanceOffsetLocation, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexAttribBinding(instanceOffsetLocation, instanceOffsetLocation);
+    glVertexBindingDivisor(instanceOffsetLocation, 1);
+    glBindVertexArray(0);
+  }
+
+  // Makes buffer hold at least size bytes, then points both vertex arrays at
+  // it
+  void grow(GLenum target, GLuint &buffer, GLsizeiptr &capacity,
+      GLsizeiptr size)
+  {
+    if (size <= capacity) {
+      return;
+    }
+    auto newCapacity = std::max<GLsizeiptr>(capacity, 4096);
+    while (newCapacity < size) {
+      newCapacity *= 2;
+    }
+    GLuint newBuffer = 0;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+    const auto used =
+        target == GL_ARRAY_BUFFER ? m_VertexSize : m_IndexSize;
+    if (buffer && used) {
+      glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+      glCopyBufferSubData(
+          GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+    capacity = newCapacity;
+
+    for (const auto vertexArray : {m_VertexArray, m_InstancedVertexArray}) {
+      glBindVertexArray(vertexArray);
+      if (target == GL_ARRAY_BUFFER) {
+        glBindVertexBuffer(0, buffer, 0, sizeof(PackedVertex));
+      } else {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+      }
+    }
+    glBindVertexArray(0);
+  }
+
+  GLuint m_VertexArray = 0;
+  GLuint m_InstancedVertexArray = 0;
+  GLuint m_VertexBuffer = 0, m_IndexBuffer = 0;
+  GLsizeiptr m_VertexCapacity = 0, m_IndexCapacity = 0;
+  GLsizeiptr m_VertexSize = 0, m_IndexSize = 0; // Bytes used
+  // Several meshes per hash if they collide
+  std::unordered_multimap<uint64_t, Mesh> m_Meshes;
+  uint32_t m_SharedCount = 0;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstring>
+#include <glad/glad.h>
+
+// Extensions missing from the glad build are looked up at runtime, their
+// constants are defined where they are used
+inline bool isExtensionSupported(const char *name)
+{
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const auto extension =
+        reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "glad/glad.h"
+
+#include <array>
+#include <cstdint>
+
+// Last values given to the GL for the state the draws change the most, so that
+// setting a value that is already current is skipped. The cache only knows
+// what went through it: the GUI and the uploads change the state between
+// frames, so beginFrame forgets everything, and code changing tracked state
+// during the draws must go through the cache (see StreamBuffer::upload) or
+// call invalidate. Setters return true if they called the GL.
+class GLStateCache
+{
+public:
+  static constexpr GLuint textureUnitCount = 8;
+
+  GLStateCache() { invalidate(); }
+
+  // Forgets the state and resets the counters
+  void beginFrame()
+  {
+    invalidate();
+    m_CallCount = 0;
+    m_SkippedCount = 0;
+  }
+
+  void invalidate()
+  {
+    m_Program = m_VertexArray = m_ActiveTexture = unknown;
+    m_DepthMask = m_DepthTest = unknown;
+    m_Buffers.fill(unknown);
+    for (auto &unit : m_Textures) {
+      unit.fill(unknown);
+    }
+  }
+
+  bool useProgram(GLuint program)
+  {
+    if (!update(m_Program, program)) {
+      return false;
+    }
+    glUseProgram(program);
+    return true;
+  }
+
+  bool bindVertexArray(GLuint vertexArray)
+  {
+    if (!update(m_VertexArray, vertexArray)) {
+      return false;
+    }
+    glBindVertexArray(vertexArray);
+    return true;
+  }
+
+  // GL_ELEMENT_ARRAY_BUFFER belongs to the vertex array and isn't tracked,
+  // nor is GL_UNIFORM_BUFFER which the uniform buffers bind directly
+  bool bindBuffer(GLenum target, GLuint buffer)
+  {
+    const auto index = getBufferIndex(target);
+    if (index < 0) {
+      ++m_CallCount;
+    } else if (!update(m_Buffers[index], buffer)) {
+      return false;
+    }
+    glBindBuffer(target, buffer);
+    return true;
+  }
+
+  // On texture unit unit, made active if needed
+  bool bindTexture(GLuint unit, GLenum target, GLuint texture)
+  {
+    const auto index = getTextureIndex(target);
+    if (index < 0 || unit >= textureUnitCount) {
+      ++m_CallCount;
+    } else if (!update(m_Textures[unit][index], texture)) {
+      return false;
+    }
+    if (update(m_ActiveTexture, GL_TEXTURE0 + unit)) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(target, texture);
+    return true;
+  }
+
+  bool setDepthMask(bool enabled)
+  {
+    if (!update(m_DepthMask, enabled)) {
+      return false;
+    }
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    return true;
+  }
+
+  bool setDepthTest(bool enabled)
+  {
+    if (!update(m_DepthTest, enabled)) {
+      return false;
+    }
+    if (enabled) {
+      glEnable(GL_DEPTH_TEST);
+    } else {
+      glDisable(GL_DEPTH_TEST);
+    }
+    return true;
+  }
+
+  // Since beginFrame
+  uint32_t getCallCount() const { return m_CallCount; }
+  uint32_t getSkippedCount() const { return m_SkippedCount; }
+
+private:
+  static constexpr GLuint unknown = ~0u; // Never a GL name
+
+  // Counts the call, or the skipped one if value is already current
+  bool update(GLuint &current, GLuint value)
+  {
+    if (current == value) {
+      ++m_SkippedCount;
+      return false;
+    }
+    current = value;
+    ++m_CallCount;
+    return true;
+  }
+
+  static int getBufferIndex(GLenum target)
+  {
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+      return 0;
+    case GL_COPY_READ_BUFFER:
+      return 1;
+    case GL_COPY_WRITE_BUFFER:
+      return 2;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return 3;
+    default:
+      return -1;
+    }
+  }
+
+  static int getTextureIndex(GLenum target)
+  {
+    switch (target) {
+    case GL_TEXTURE_2D:
+      return 0;
+    case GL_TEXTURE_CUBE_MAP:
+      return 1;
+    default:
+      return -1;
+    }
+  }
+
+  GLuint m_Program, m_VertexArray, m_ActiveTexture;
+  GLuint m_DepthMask, m_DepthTest; // GL_TRUE or GL_FALSE when known
+  // Indexed by getBufferIndex, and per unit by getTextureIndex
+  std::array<GLuint, 4> m_Buffers;
+  std::array<std::array<GLuint, 2>, textureUnitCount> m_Textures;
+  uint32_t m_CallCount = 0;
+  uint32_t m_SkippedCount = 0;
+};
@@ -0,0 +1,164 @@
+#include "glb.hpp"
+
+#include <cstring>
+#include <json.hpp>
+
+namespace
+{
+// '<' can't appear in a valid uri
+const std::string glbChunkUri = "<glb-chunk>";
+
+constexpr uint32_t glbMagic = 0x46546C67;     // "glTF"
+constexpr uint32_t jsonChunkType = 0x4E4F534A; // "JSON"
+constexpr uint32_t binChunkType = 0x004E4942;  // "BIN\0"
+
+struct GlbChunk
+{
+  const unsigned char *data = nullptr;
+  uint32_t size = 0;
+};
+
+uint32_t readUint32(const unsigned char *data)
+{
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// tinygltf joins the uri with the base directory
+bool endsWithGlbChunkUri(const std::string &path)
+{
+  return path.size() >= glbChunkUri.size() &&
+         path.compare(path.size() - glbChunkUri.size(), glbChunkUri.size(),
+             glbChunkUri) == 0;
+}
+
+bool fileExists(const std::string &path, void *userData)
+{
+  return endsWithGlbChunkUri(path) || tinygltf::FileExists(path, userData);
+}
+
+std::string expandFilePath(const std::string &path, void *userData)
+{
+  return endsWithGlbChunkUri(path) ? path
+                                   : tinygltf::ExpandFilePath(path, userData);
+}
+
+// The chunk is given as one byte, what is needed for tinygltf to accept it
+bool readWholeFile(std::vector<unsigned char> *out, std::string *err,
+    const std::string &path, void *userData)
+{
+  if (endsWithGlbChunkUri(path)) {
+    out->assign(1, 0);
+    return true;
+  }
+  return tinygltf::ReadWholeFile(out, err, path, userData);
+}
+} // namespace
+
+bool isGlbChunkUri(const std::string &uri) { return uri == glbChunkUri; }
+
+bool loadMappedGlb(tinygltf::TinyGLTF &loader, const MappedFile &file,
+    const std::string &baseDirectory, tinygltf::Model &model,
+    std::vector<BufferData> &buffers, std::string *err, std::string *warn)
+{
+  // Header, then a JSON chunk and an optional BIN chunk
+  const auto data = file.data();
+  const auto size = file.size();
+  if (size < 20 || readUint32(data) != glbMagic || readUint32(data + 4) != 2 ||
+      readUint32(data + 8) > size) {
+    *err += "Invalid GLB header.\n";
+    return false;
+  }
+  const auto fileSize = size_t(readUint32(data + 8));
+  GlbChunk json{data + 20, readUint32(data + 12)};
+  if (readUint32(data + 16) != jsonChunkType || json.size > fileSize - 20) {
+    *err += "Invalid GLB JSON chunk.\n";
+    return false;
+  }
+  GlbChunk bin;
+  const auto binOffset = 20 + ((size_t(json.size) + 3) & ~size_t(3));
+  if (binOffset + 8 <= fileSize &&
+      readUint32(data + binOffset + 4) == binChunkType) {
+    bin = {data + binOffset + 8, readUint32(data + binOffset)};
+    if (bin.size > fileSize - binOffset - 8) {
+      *err += "Invalid GLB BIN chunk.\n";
+      return false;
+    }
+  }
+
+  auto document = nlohmann::json::parse(json.data, json.data + json.size,
+      nullptr, /* allow_exceptions */ false);
+  if (document.is_discarded() || !document.is_object()) {
+    *err += "Invalid GLB JSON chunk.\n";
+    return false;
+  }
+
+  // Buffers and images stored in the BIN chunk are replaced by the marker,
+  // malformed ones are left to tinygltf to report
+  std::vector<std::pair<size_t, uint64_t>> binBuffers; // Index, byteLength
+  const auto jsonBuffers = document.find("buffers");
+  for (size_t i = 0;
+       jsonBuffers != document.end() && jsonBuffers->is_array() &&
+       i < jsonBuffers->size();
+       ++i) {
+    auto &buffer = (*jsonBuffers)[i];
+    if (!buffer.is_object() || buffer.count("uri") ||
+        !buffer.count("byteLength") ||
+        !buffer["byteLength"].is_number_unsigned()) {
+      continue;
+    }
+    const auto byteLength = buffer["byteLength"].get<uint64_t>();
+    if (!bin.data || byteLength > bin.size) {
+      *err += "GLB buffer larger than the BIN chunk.\n";
+      return false;
+    }
+    binBuffers.emplace_back(i, byteLength);
+    buffer["uri"] = glbChunkUri;
+    buffer["byteLength"] = 1;
+  }
+  std::vector<std::pair<size_t, int>> bufferViewImages; // Index, bufferView
+  const auto jsonImages = document.find("images");
+  for (size_t i = 0;
+       jsonImages != document.end() && jsonImages->is_array() &&
+       i < jsonImages->size();
+       ++i) {
+    auto &image = (*jsonImages)[i];
+    if (!image.is_object() || !image.count("bufferView") ||
+        !image["bufferView"].is_number_integer()) {
+      continue;
+    }
+    bufferViewImages.emplace_back(i, image["bufferView"].get<int>());
+    image.erase("bufferView");
+    image["uri"] = glbChunkUri;
+  }
+  const auto patched = document.dump();
+  document = nlohmann::json{};
+
+  loader.SetFsCallbacks({&fileExists, &expandFilePath, &readWholeFile,
+      &tinygltf::WriteWholeFile, nullptr});
+  const auto ret = loader.LoadASCIIFromString(&model, err, warn,
+      patched.data(), static_cast<unsigned int>(patched.size()),
+      baseDirectory);
+  loader.SetFsCallbacks({&tinygltf::FileExists, &tinygltf::ExpandFilePath,
+      &tinygltf::ReadWholeFile, &tinygltf::WriteWholeFile, nullptr});
+  if (!ret) {
+    return false;
+  }
+
+  for (const auto &image : bufferViewImages) {
+    auto &modelImage = model.images[image.first];
+    modelImage.uri.clear();
+    modelImage.image.clear();
+    modelImage.bufferView = image.second;
+  }
+  for (const auto &buffer : binBuffers) {
+    model.buffers[buffer.first].uri.clear();
+    model.buffers[buffer.first].data.clear();
+  }
+  buffers = getBufferData(model);
+  for (const auto &buffer : binBuffers) {
+    buffers[buffer.first] = {bin.data, size_t(buffer.second)};
+  }
+  return true;
+}
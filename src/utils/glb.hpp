@@ -0,0 +1,21 @@
+#pragma once
+
+#include "mappedFile.hpp"
+#include "sceneData.hpp"
+
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+// Uri given to tinygltf in place of the BIN chunk of a mapped GLB file and of
+// the images it stores, which tinygltf must not load
+bool isGlbChunkUri(const std::string &uri);
+
+// Loads a GLB file mapped in memory without copying its BIN chunk: only the
+// JSON chunk is parsed. The buffer stored in the BIN chunk stays empty in
+// model.buffers, buffers points into the mapping instead. Images stored in
+// buffer views keep their bufferView and no data, like when they are loaded
+// with an image loader that keeps nothing. The file must outlive buffers.
+bool loadMappedGlb(tinygltf::TinyGLTF &loader, const MappedFile &file,
+    const std::string &baseDirectory, tinygltf::Model &model,
+    std::vector<BufferData> &buffers, std::string *err, std::string *warn);
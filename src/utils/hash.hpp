@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 64 bits hash with the rounds of xxHash64, on a single lane: 8 bytes at a
+// time so that hashing a multi-gigabyte file stays far cheaper than parsing
+// it, and a final avalanche so that every input bit changes every output bit.
+// Not meant to resist collisions crafted on purpose, only to key caches by
+// content. A hash can be passed back as the seed to chain several inputs.
+constexpr uint64_t hashSeed = 0;
+
+namespace hashDetail
+{
+constexpr uint64_t prime1 = 11400714785074694791ull;
+constexpr uint64_t prime2 = 14029467366897019727ull;
+constexpr uint64_t prime3 = 1609587929392839161ull;
+constexpr uint64_t prime4 = 9650029242287828579ull;
+constexpr uint64_t prime5 = 2870177450012600261ull;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+} // namespace hashDetail
+
+inline uint64_t hashBytes(
+    const void *data, size_t size, uint64_t hash = hashSeed)
+{
+  using namespace hashDetail;
+  const auto bytes = static_cast<const unsigned char *>(data);
+  hash += prime5 + size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    hash ^= rotl(word * prime2, 31) * prime1;
+    hash = rotl(hash, 27) * prime1 + prime4;
+  }
+  for (; i < size; ++i) {
+    hash ^= bytes[i] * prime5;
+    hash = rotl(hash, 11) * prime1;
+  }
+  hash ^= hash >> 33;
+  hash *= prime2;
+  hash ^= hash >> 29;
+  hash *= prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+inline uint64_t hashString(const std::string &str, uint64_t hash = hashSeed)
+{
+  return hashBytes(str.data(), str.size(), hash);
+}
+
+// 16 hexadecimal digits, for file names
+inline std::string toHexString(uint64_t hash)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string str(16, '0');
+  for (int i = 15; i >= 0; --i, hash >>= 4) {
+    str[i] = digits[hash & 0xf];
+  }
+  return str;
+}
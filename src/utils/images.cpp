@@ -1,9 +1,271 @@
 #include "images.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <glad/glad.h>
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// From EXT_texture_compression_s3tc, which glad wasn't generated with
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace
+{
+// Averages the 2x2 pixels of rows row0 and row1 under count pixels of dst,
+// rounding like (a + b + c + d + 2) / 4 so that every path gives the same
+// result
+void downsampleRow(const unsigned char *row0, const unsigned char *row1,
+    unsigned char *dst, int count)
+{
+  int x = 0;
+#ifdef __SSE2__
+  // 4 pixels per iteration, from 8 pixels of each row widened to 16 bits
+  const auto zero = _mm_setzero_si128();
+  const auto two = _mm_set1_epi16(2);
+  for (; x + 4 <= count; x += 4) {
+    const auto a0 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+    const auto a1 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x + 16));
+    const auto b0 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+    const auto b1 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x + 16));
+    // Vertical sums, two pixels per register
+    const auto s01 = _mm_add_epi16(
+        _mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+    const auto s23 = _mm_add_epi16(
+        _mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+    const auto s45 = _mm_add_epi16(
+        _mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+    const auto s67 = _mm_add_epi16(
+        _mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+    // Horizontal sums of the pairs of pixels
+    const auto lo = _mm_add_epi16(
+        _mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+    const auto hi = _mm_add_epi16(
+        _mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+    _mm_storeu_si128((__m128i *)(dst + 4 * x),
+        _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+            _mm_srli_epi16(_mm_add_epi16(hi, two), 2)));
+  }
+#endif
+  for (; x < count; ++x) {
+    for (int c = 0; c < 4; ++c) {
+      const auto sum = row0[8 * x + c] + row0[8 * x + 4 + c] +
+                       row1[8 * x + c] + row1[8 * x + 4 + c];
+      dst[4 * x + c] = (unsigned char)((sum + 2) / 4);
+    }
+  }
+}
+
+// Texel of a source axis and its weight in a destination texel
+struct FilterTap
+{
+  int index;
+  float weight;
+};
+
+// Box filter halving an axis of srcSize texels, at destination texel i. On
+// an odd axis each destination texel covers 2 + 1 / dstSize source texels,
+// spread over 3 taps, so that the last texel is kept.
+int getFilterTaps(int srcSize, int dstSize, int i, FilterTap taps[3])
+{
+  if (srcSize == 1) {
+    taps[0] = {0, 1.f};
+    return 1;
+  }
+  if (srcSize % 2 == 0) {
+    taps[0] = {2 * i, 0.5f};
+    taps[1] = {2 * i + 1, 0.5f};
+    return 2;
+  }
+  const auto scale = 1.f / srcSize;
+  taps[0] = {2 * i, float(dstSize - i) * scale};
+  taps[1] = {2 * i + 1, float(dstSize) * scale};
+  taps[2] = {2 * i + 2, float(i + 1) * scale};
+  return 3;
+}
+
+// Next level of a level with an odd side, see getFilterTaps
+void downsampleOdd(const unsigned char *src, int srcWidth, int srcHeight,
+    unsigned char *dst, int dstWidth, int dstHeight)
+{
+  FilterTap tapsX[3], tapsY[3];
+  for (int y = 0; y < dstHeight; ++y) {
+    const auto countY = getFilterTaps(srcHeight, dstHeight, y, tapsY);
+    for (int x = 0; x < dstWidth; ++x) {
+      const auto countX = getFilterTaps(srcWidth, dstWidth, x, tapsX);
+      float sum[4] = {};
+      for (int j = 0; j < countY; ++j) {
+        const auto row = src + size_t(tapsY[j].index) * srcWidth * 4;
+        for (int i = 0; i < countX; ++i) {
+          const auto texel = row + size_t(tapsX[i].index) * 4;
+          const auto weight = tapsY[j].weight * tapsX[i].weight;
+          for (int c = 0; c < 4; ++c) {
+            sum[c] += weight * texel[c];
+          }
+        }
+      }
+      const auto dstTexel = dst + (size_t(y) * dstWidth + x) * 4;
+      for (int c = 0; c < 4; ++c) {
+        dstTexel[c] = (unsigned char)std::min(sum[c] + 0.5f, 255.f);
+      }
+    }
+  }
+}
+
+uint64_t getBlockBytes(PixelFormat format)
+{
+  switch (format) {
+  case PixelFormat::Bc1:
+    return 8;
+  case PixelFormat::Bc7:
+    return 16;
+  default:
+    return 4;
+  }
+}
+} // namespace
+
+int getBlockSize(PixelFormat format)
+{
+  return format == PixelFormat::Rgba8 ? 1 : 4;
+}
+
+uint32_t getInternalFormat(PixelFormat format)
+{
+  switch (format) {
+  case PixelFormat::Bc1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case PixelFormat::Bc7:
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  default:
+    return GL_RGBA8;
+  }
+}
+
+uint32_t getMipLevelCount(int width, int height)
+{
+  uint32_t levelCount = 1;
+  for (auto size = std::max(width, height); size > 1; size /= 2) {
+    ++levelCount;
+  }
+  return levelCount;
+}
+
+int getMipLevelRows(int height, uint32_t level, PixelFormat format)
+{
+  const auto blockSize = getBlockSize(format);
+  return (std::max(height >> level, 1) + blockSize - 1) / blockSize;
+}
+
+uint64_t getMipLevelRowSize(int width, uint32_t level, PixelFormat format)
+{
+  const auto blockSize = getBlockSize(format);
+  const uint64_t blocks = (std::max(width >> level, 1) + blockSize - 1) /
+                          blockSize;
+  return blocks * getBlockBytes(format);
+}
+
+uint64_t getMipLevelOffset(
+    int width, int height, uint32_t level, PixelFormat format)
+{
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < level; ++i) {
+    offset += getMipLevelRows(height, i, format) *
+              getMipLevelRowSize(width, i, format);
+  }
+  return offset;
+}
+
+void generateMipChain(
+    int width, int height, std::vector<unsigned char> &pixels)
+{
+  const auto levelCount = getMipLevelCount(width, height);
+  pixels.resize(getMipLevelOffset(width, height, levelCount));
+
+  size_t srcOffset = 0;
+  for (uint32_t level = 1; level < levelCount; ++level) {
+    const auto srcWidth = std::max(width >> (level - 1), 1);
+    const auto srcHeight = std::max(height >> (level - 1), 1);
+    const auto dstWidth = std::max(width >> level, 1);
+    const auto dstHeight = std::max(height >> level, 1);
+    const auto src = pixels.data() + srcOffset;
+    const auto dst = src + size_t(srcWidth) * srcHeight * 4;
+    srcOffset += size_t(srcWidth) * srcHeight * 4;
+    if ((srcWidth > 1 && srcWidth % 2) || (srcHeight > 1 && srcHeight % 2)) {
+      downsampleOdd(src, srcWidth, srcHeight, dst, dstWidth, dstHeight);
+      continue;
+    }
+    for (int y = 0; y < dstHeight; ++y) {
+      // Even sizes, a side of 1 repeats its only row or column
+      const auto row0 =
+          src + size_t(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+      const auto row1 =
+          src + size_t(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+      const auto dstRow = dst + size_t(y) * dstWidth * 4;
+      if (srcWidth > 1) {
+        downsampleRow(row0, row1, dstRow, dstWidth);
+        continue;
+      }
+      for (int c = 0; c < 4; ++c) {
+        dstRow[c] = (unsigned char)((2 * row0[c] + 2 * row1[c] + 2) / 4);
+      }
+    }
+  }
+}
+
+void uploadMipLevelRows(uint32_t target, const ImageMips &mips,
+    uint32_t level, int firstRow, int rowCount, const void *pixels)
+{
+  const auto width = std::max(mips.width >> level, 1);
+  const auto height = std::max(mips.height >> level, 1);
+  const auto blockSize = getBlockSize(mips.format);
+  // The last row of blocks may go past the edge of the level
+  const auto y = firstRow * blockSize;
+  const auto rows = std::min(rowCount * blockSize, height - y);
+  if (mips.format == PixelFormat::Rgba8) {
+    glTexSubImage2D(target, level, 0, y, width, rows, GL_RGBA,
+        GL_UNSIGNED_BYTE, pixels);
+  } else {
+    glCompressedTexSubImage2D(target, level, 0, y, width, rows,
+        getInternalFormat(mips.format),
+        GLsizei(rowCount * getMipLevelRowSize(mips.width, level, mips.format)),
+        pixels);
+  }
+}
+
+void specifyMipLevel(uint32_t target, const ImageMips &mips, uint32_t level,
+    const void *pixels)
+{
+  const auto width = std::max(mips.width >> level, 1);
+  const auto height = std::max(mips.height >> level, 1);
+  const auto internalFormat = getInternalFormat(mips.format);
+  if (mips.format == PixelFormat::Rgba8) {
+    glTexImage2D(target, level, internalFormat, width, height, 0, GL_RGBA,
+        GL_UNSIGNED_BYTE, pixels);
+  } else {
+    glCompressedTexImage2D(target, level, internalFormat, width, height, 0,
+        GLsizei(getMipLevelRows(mips.height, level, mips.format) *
+                getMipLevelRowSize(mips.width, level, mips.format)),
+        pixels);
+  }
+}
+
+void releaseMipLevel(uint32_t target, const ImageMips &mips, uint32_t level)
+{
+  const auto internalFormat = getInternalFormat(mips.format);
+  if (mips.format == PixelFormat::Rgba8) {
+    glTexImage2D(target, level, internalFormat, 0, 0, 0, GL_RGBA,
+        GL_UNSIGNED_BYTE, nullptr);
+  } else {
+    glCompressedTexImage2D(
+        target, level, internalFormat, 0, 0, 0, 0, nullptr);
+  }
+}
+
 void renderToImage(size_t width, size_t height, size_t numComponents,
     unsigned char *outPixels, std::function<void()> drawScene)
 {
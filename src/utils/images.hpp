@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <vector>
 
 template <typename ComponentType>
 void flipImageYAxis(std::size_t width, std::size_t height,
@@ -17,6 +19,63 @@ void flipImageYAxis(std::size_t width, std::size_t height,
   }
 }
 
+// Layouts of the levels of a mip chain
+enum class PixelFormat : uint32_t
+{
+  Rgba8,
+  Bc1, // 4x4 blocks of 8 bytes, opaque
+  Bc7, // 4x4 blocks of 16 bytes
+};
+
+// Mip chain of an image, levels are tightly packed one after the other (see
+// generateMipChain and compressMipChain). Empty if the image couldn't be
+// decoded.
+struct ImageMips
+{
+  int32_t width = 0, height = 0;
+  uint32_t levelCount = 0;
+  PixelFormat format = PixelFormat::Rgba8;
+  const unsigned char *pixels = nullptr;
+  uint64_t size = 0;
+};
+
+// Side of the blocks of format in pixels, 1 for Rgba8
+int getBlockSize(PixelFormat format);
+
+// GL internal format of the textures holding format
+uint32_t getInternalFormat(PixelFormat format);
+
+// Number of levels of a full mip chain, down to 1x1
+uint32_t getMipLevelCount(int width, int height);
+
+// Rows of a level (of blocks for block formats), and their size in bytes
+int getMipLevelRows(int height, uint32_t level, PixelFormat format);
+uint64_t getMipLevelRowSize(int width, uint32_t level, PixelFormat format);
+
+// Offset of a level in a mip chain, which is also the size of the levels
+// before it
+uint64_t getMipLevelOffset(int width, int height, uint32_t level,
+    PixelFormat format = PixelFormat::Rgba8);
+
+// pixels holds an RGBA8 image, the following levels of its mip chain are
+// appended to it, each one a box filter of the previous one: 2x2 texels, or
+// 3 weighted texels along odd sides so that their last row and column count
+void generateMipChain(
+    int width, int height, std::vector<unsigned char> &pixels);
+
+// Uploads rowCount rows of a level of mips, starting at firstRow, to the
+// texture bound to target. pixels is a pointer, or an offset in the bound
+// GL_PIXEL_UNPACK_BUFFER.
+void uploadMipLevelRows(uint32_t target, const ImageMips &mips,
+    uint32_t level, int firstRow, int rowCount, const void *pixels);
+
+// Allocates a level of the mutable texture bound to target and uploads it
+// from pixels (same as uploadMipLevelRows). releaseMipLevel makes it empty
+// again.
+void specifyMipLevel(uint32_t target, const ImageMips &mips, uint32_t level,
+    const void *pixels);
+void releaseMipLevel(uint32_t target, const ImageMips &mips, uint32_t level);
+
 void renderToImage(std::size_t width, std::size_t height,
     std::size_t numComponents, unsigned char *outPixels,
     std::function<void()> drawScene);
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "frustum.hpp"
+#include "glStateCache.hpp"
 #include "glad/glad.h"
-#include "uniformHandler.hpp"
+#include "streamBuffer.hpp"
+#include "uniformBuffers.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec3.hpp>
@@ -30,12 +33,11 @@ public:
     return LineVertex::sizeOfVertex();
   }
 
+  // The stream buffer and the vao are kept for the next line
   void clearVertex()
   {
     m_Vertices.clear();
     m_nVertexCount = 0;
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
     drawing = false;
     collided = false;
   }
@@ -46,7 +48,7 @@ public:
     if (collided) {
       const auto center = glm::vec3(start.x, start.y, start.z);
       build(center);
-      initObj(0);
+      upload(0);
       drawing = true;
       return collided;
     }
@@ -71,7 +73,7 @@ public:
 
     // std::cout << center << ", " << end << std::endl;
     build(center);
-    initObj(0);
+    upload(0);
     drawing = true;
 
     return collided;
@@ -82,12 +84,6 @@ public:
     return sqrt(pow(maxDist, 2) + pow(center, 2));
   }
 
-  void initObj(GLuint vPos)
-  {
-    initVboPointer();
-    initVaoPointer(vPos);
-  }
-
   kln::translator restrictPosition(
       const kln::point &playerPos, const bool isGrounded, const glm::vec3 &pos)
   {
@@ -119,25 +115,25 @@ public:
     kln::rotor(M_PI * 0.032, 0, 0, -1.f);
   }
 
-  void draw(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
-      const UniformHandler &handler) const
+  void draw(GLStateCache &state, ObjectUniformBuffer &objects,
+      Frustum *frustum = nullptr) const
   {
+    if (drawing && frustum) {
+      kln::Aabb bounds;
+      for (const auto &vertex : m_Vertices) {
+        bounds.grow(vertex.position);
+      }
+      if (!frustum->isVisible(bounds)) {
+        return;
+      }
+    }
     if (drawing) {
       //   std::cout << "drawing" << std::endl;
-      const auto mvMatrix = viewMatrix * glm::mat4(1.f);
-      const auto mvpMatrix = projMatrix * mvMatrix;
-      const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-      glUniformMatrix4fv(
-          handler.uModelViewProjMatrix, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-      glUniformMatrix4fv(
-          handler.uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-      glUniformMatrix4fv(
-          handler.uNormalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-      glBindBuffer(GL_ARRAY_BUFFER, vbo);
-      glBindVertexArray(vao);
+      objects.bind(ObjectUniformBuffer::identitySlot); // World space vertices
+      state.bindVertexArray(vao);
+      glBindVertexBuffer(
+          0, m_Stream.getBuffer(), m_StreamOffset, getVertexSize());
       glDrawArrays(GL_LINES, 0, getVertexCount());
-      glBindVertexArray(0);
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
   }
 
@@ -152,29 +148,33 @@ private:
     m_nVertexCount = 2;
   }
 
+  // Writes the vertices in the stream buffer, the vao is created once and
+  // only gets the offset of the vertices at draw time
+  void upload(GLuint vPos)
+  {
+    if (!vao) {
+      initVaoPointer(vPos);
+    }
+    m_StreamOffset = m_Stream.upload(getDataPointer(),
+        getVertexCount() * getVertexSize(), getVertexSize());
+  }
+
   void initVaoPointer(GLuint vPos)
   {
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     glEnableVertexAttribArray(vPos);
-    glVertexAttribPointer(vPos, 3, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(LineVertex, position));
+    glVertexAttribFormat(
+        vPos, 3, GL_FLOAT, GL_FALSE, offsetof(LineVertex, position));
+    glVertexAttribBinding(vPos, 0);
     glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-  }
-
-  void initVboPointer()
-  {
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, getVertexCount() * getVertexSize(),
-        getDataPointer(), GL_STATIC_DRAW);
   }
 
   std::vector<LineVertex> m_Vertices;
   GLsizei m_nVertexCount;
-  GLuint vbo;
-  GLuint vao;
+  GLuint vao = 0;
+  StreamBuffer m_Stream{4 * 1024};
+  GLintptr m_StreamOffset = 0;
   bool drawing, collided = false;
   float ropeLength = 0.f;
 };
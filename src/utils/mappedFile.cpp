@@ -0,0 +1,97 @@
+#include "mappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const fs::path &path)
+{
+  close();
+  const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  const auto mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_File = file;
+  m_Mapping = mapping;
+  m_Data = static_cast<const unsigned char *>(data);
+  m_Size = size_t(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (m_Data) {
+    UnmapViewOfFile(m_Data);
+    CloseHandle(m_Mapping);
+    CloseHandle(m_File);
+  }
+  m_Data = nullptr;
+  m_Size = 0;
+  m_File = nullptr;
+  m_Mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const fs::path &path)
+{
+  close();
+  const auto file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(file, &status) != 0 || status.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+  const auto size = size_t(status.st_size);
+  const auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping keeps the file alive
+  ::close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  m_Data = static_cast<const unsigned char *>(data);
+  m_Size = size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (m_Data) {
+    munmap(const_cast<unsigned char *>(m_Data), m_Size);
+  }
+  m_Data = nullptr;
+  m_Size = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are loaded by the system
+// as they are read, so nothing is copied until the data is actually used.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Returns false if the file can't be opened, empty files can't be mapped
+  bool open(const fs::path &path);
+  void close();
+
+  const unsigned char *data() const { return m_Data; }
+  size_t size() const { return m_Size; }
+
+private:
+  const unsigned char *m_Data = nullptr;
+  size_t m_Size = 0;
+#ifdef _WIN32
+  void *m_File = nullptr;
+  void *m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,217 @@
+#include "meshOptimizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+std::vector<uint32_t> optimizeVertexCache(
+    uint32_t *indices, size_t indexCount, uint32_t vertexCount)
+{
+  const auto triangleCount = indexCount / 3;
+  std::vector<uint32_t> clusters;
+  if (!triangleCount) {
+    return clusters;
+  }
+
+  // Triangles of each vertex, in compressed rows
+  std::vector<uint32_t> liveCounts(vertexCount, 0);
+  for (size_t i = 0; i < 3 * triangleCount; ++i) {
+    ++liveCounts[indices[i]];
+  }
+  std::vector<uint32_t> firstTriangles(vertexCount + 1, 0);
+  std::partial_sum(
+      begin(liveCounts), end(liveCounts), begin(firstTriangles) + 1);
+  std::vector<uint32_t> vertexTriangles(3 * triangleCount);
+  {
+    auto cursors = firstTriangles;
+    for (size_t i = 0; i < 3 * triangleCount; ++i) {
+      vertexTriangles[cursors[indices[i]]++] = uint32_t(i / 3);
+    }
+  }
+
+  const auto k = vertexCacheSize;
+  std::vector<uint32_t> cacheTimes(vertexCount, 0);
+  std::vector<unsigned char> emitted(triangleCount, 0);
+  std::vector<uint32_t> deadEnds; // Recently used vertices, most recent last
+  std::vector<uint32_t> output;
+  output.reserve(3 * triangleCount);
+  std::vector<uint32_t> candidates;
+  uint32_t time = k + 1;
+  uint32_t cursor = 0; // Vertices before it have no live triangle
+
+  // Most recent vertex that still has triangles to emit, then the first one
+  // in input order
+  const auto skipDeadEnd = [&]() -> int64_t {
+    while (!deadEnds.empty()) {
+      const auto vertex = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveCounts[vertex]) {
+        return vertex;
+      }
+    }
+    for (; cursor < vertexCount; ++cursor) {
+      if (liveCounts[cursor]) {
+        return cursor;
+      }
+    }
+    return -1;
+  };
+
+  int64_t fan = skipDeadEnd();
+  clusters.push_back(0);
+  while (fan >= 0) {
+    candidates.clear();
+    for (auto t = firstTriangles[fan]; t < firstTriangles[fan + 1]; ++t) {
+      const auto triangle = vertexTriangles[t];
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = 1;
+      for (int c = 0; c < 3; ++c) {
+        const auto vertex = indices[3 * triangle + c];
+        output.push_back(vertex);
+        deadEnds.push_back(vertex);
+        candidates.push_back(vertex);
+        --liveCounts[vertex];
+        if (time - cacheTimes[vertex] > k) {
+          cacheTimes[vertex] = time++;
+        }
+      }
+    }
+
+    // Next fan: the candidate that stays cached the longest once its
+    // remaining triangles are emitted
+    int64_t next = -1;
+    int64_t bestPriority = -1;
+    for (const auto vertex : candidates) {
+      if (!liveCounts[vertex]) {
+        continue;
+      }
+      int64_t priority = 0;
+      if (time - cacheTimes[vertex] + 2 * liveCounts[vertex] <= k) {
+        priority = time - cacheTimes[vertex];
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        next = vertex;
+      }
+    }
+    // Clusters end where the cache is about to be flushed anyway: when
+    // nothing cached is left to fan around, or when the best candidate will
+    // be evicted before its triangles are emitted
+    const auto emittedCount = uint32_t(output.size() / 3);
+    if (next < 0) {
+      next = skipDeadEnd();
+      if (next >= 0) {
+        clusters.push_back(emittedCount);
+      }
+    } else if (bestPriority == 0 &&
+               emittedCount - clusters.back() >= vertexCacheSize) {
+      clusters.push_back(emittedCount);
+    }
+    fan = next;
+  }
+  std::copy(begin(output), end(output), indices);
+  return clusters;
+}
+
+void optimizeOverdraw(uint32_t *indices, size_t indexCount,
+    const std::vector<uint32_t> &clusters, const unsigned char *positions,
+    size_t positionStride)
+{
+  const auto triangleCount = uint32_t(indexCount / 3);
+  if (clusters.size() < 2) {
+    return;
+  }
+  const auto getPosition = [&](uint32_t index) {
+    glm::vec3 position;
+    std::memcpy(
+        &position, positions + index * positionStride, sizeof(position));
+    return position;
+  };
+
+  // Area weighted centroid and normal of each cluster, and of the mesh
+  struct Cluster
+  {
+    uint32_t first, end;
+    glm::vec3 centroid, normal;
+    float area;
+    float sortKey;
+  };
+  std::vector<Cluster> sorted;
+  glm::vec3 meshCentroid(0.f);
+  float meshArea = 0.f;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    Cluster cluster{clusters[c],
+        c + 1 < clusters.size() ? clusters[c + 1] : triangleCount,
+        glm::vec3(0.f), glm::vec3(0.f), 0.f, 0.f};
+    for (auto t = cluster.first; t < cluster.end; ++t) {
+      const auto p0 = getPosition(indices[3 * t]);
+      const auto p1 = getPosition(indices[3 * t + 1]);
+      const auto p2 = getPosition(indices[3 * t + 2]);
+      const auto normal = glm::cross(p1 - p0, p2 - p0); // Twice the area
+      const auto area = glm::length(normal);
+      cluster.centroid += area * (p0 + p1 + p2) / 3.f;
+      cluster.normal += normal;
+      cluster.area += area;
+    }
+    meshCentroid += cluster.centroid;
+    meshArea += cluster.area;
+    if (cluster.area > 0.f) {
+      cluster.centroid /= cluster.area;
+    }
+    sorted.push_back(cluster);
+  }
+  if (meshArea > 0.f) {
+    meshCentroid /= meshArea;
+  }
+  for (auto &cluster : sorted) {
+    cluster.sortKey =
+        glm::dot(cluster.centroid - meshCentroid, cluster.normal);
+  }
+  std::stable_sort(begin(sorted), end(sorted),
+      [](const Cluster &lhs, const Cluster &rhs) {
+        return lhs.sortKey > rhs.sortKey;
+      });
+
+  std::vector<uint32_t> output;
+  output.reserve(3 * triangleCount);
+  for (const auto &cluster : sorted) {
+    output.insert(end(output), indices + 3 * cluster.first,
+        indices + 3 * cluster.end);
+  }
+  std::copy(begin(output), end(output), indices);
+}
+
+uint32_t optimizeVertexFetch(uint32_t *indices, size_t indexCount,
+    uint32_t vertexCount, std::vector<uint32_t> &remap)
+{
+  constexpr auto unused = UINT32_MAX;
+  std::vector<uint32_t> newIndices(vertexCount, unused);
+  remap.clear();
+  for (size_t i = 0; i < indexCount; ++i) {
+    auto &newIndex = newIndices[indices[i]];
+    if (newIndex == unused) {
+      newIndex = uint32_t(remap.size());
+      remap.push_back(indices[i]);
+    }
+    indices[i] = newIndex;
+  }
+  return uint32_t(remap.size());
+}
+
+float getAverageCacheMissRatio(
+    const uint32_t *indices, size_t indexCount, uint32_t vertexCount)
+{
+  // FIFO: a vertex is cached if it entered less than vertexCacheSize misses
+  // ago
+  std::vector<uint64_t> entered(vertexCount, 0);
+  uint64_t misses = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    auto &time = entered[indices[i]];
+    if (!time || misses - time >= vertexCacheSize) {
+      time = ++misses;
+    }
+  }
+  return indexCount >= 3 ? float(misses) / (indexCount / 3) : 0.f;
+}
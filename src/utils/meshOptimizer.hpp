@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Load time reordering of indexed triangle lists, so that exporter orders
+// don't cost vertex shading, overdraw or vertex fetches at draw time.
+// Indices must all be below vertexCount.
+
+// Post-transform cache size assumed by the reordering, small enough to hold
+// on every GPU
+constexpr uint32_t vertexCacheSize = 16;
+
+// Reorders triangles for the post-transform vertex cache (Tipsify, Sander et
+// al. 2007): triangles are emitted in fans around the vertex most likely to
+// still be cached. Returns the first triangle of each cluster, where the
+// order can be changed without hurting the cache (see optimizeOverdraw).
+std::vector<uint32_t> optimizeVertexCache(
+    uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+
+// Sorts the clusters of optimizeVertexCache so that the ones facing away from
+// the center of the mesh, likely to occlude the others, are drawn first.
+// positions are read at positions + i * positionStride.
+void optimizeOverdraw(uint32_t *indices, size_t indexCount,
+    const std::vector<uint32_t> &clusters, const unsigned char *positions,
+    size_t positionStride);
+
+// Renumbers vertices in the order in which the indices first use them, so
+// that vertex fetches walk memory linearly. Fills remap with the old index of
+// each new vertex and returns the number of vertices used.
+uint32_t optimizeVertexFetch(uint32_t *indices, size_t indexCount,
+    uint32_t vertexCount, std::vector<uint32_t> &remap);
+
+// Average number of vertices transformed per triangle with a FIFO cache of
+// vertexCacheSize entries, between 0.5 (ideal) and 3
+float getAverageCacheMissRatio(
+    const uint32_t *indices, size_t indexCount, uint32_t vertexCount);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue (Vyukov's algorithm): any thread can push or pop
+// without locking, each cell carrying a sequence number that tells whether
+// it is ready to be written or read. Used to hand the results of the loading
+// workers to the GL thread, which must never block on them.
+template <typename T> class MpmcQueue
+{
+public:
+  // capacity is rounded up to a power of two
+  explicit MpmcQueue(size_t capacity = 256)
+  {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    m_Mask = size - 1;
+    m_Cells = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+      m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpmcQueue(const MpmcQueue &) = delete;
+  MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+  // Returns false if the queue is full
+  bool tryPush(T &&value)
+  {
+    auto position = m_Tail.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &cell = m_Cells[position & m_Mask];
+      const auto sequence = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = intptr_t(sequence) - intptr_t(position);
+      if (diff == 0) {
+        if (m_Tail.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = m_Tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Returns false if the queue is empty
+  bool tryPop(T &value)
+  {
+    auto position = m_Head.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &cell = m_Cells[position & m_Mask];
+      const auto sequence = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = intptr_t(sequence) - intptr_t(position + 1);
+      if (diff == 0) {
+        if (m_Head.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          value = std::move(cell.value);
+          cell.sequence.store(
+              position + m_Mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = m_Head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Producers and consumers don't share a cache line
+  alignas(64) std::atomic<size_t> m_Tail{0};
+  alignas(64) std::atomic<size_t> m_Head{0};
+  std::unique_ptr<Cell[]> m_Cells;
+  size_t m_Mask;
+};
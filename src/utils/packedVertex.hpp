@@ -0,0 +1,65 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+// Vertex of the built-in shapes in 16 bytes instead of 32 with floats:
+// half float positions, normals in GL_INT_2_10_10_10_REV and texture
+// coordinates in normalized unsigned shorts (so in [0, 1]). The vertex fetch
+// decodes them, the shaders still read vec3/vec2 attributes.
+struct PackedVertex
+{
+  PackedVertex(
+      const glm::vec3 &pos, const glm::vec3 &norm, const glm::vec2 &tex) :
+      position{glm::packHalf1x16(pos.x), glm::packHalf1x16(pos.y),
+          glm::packHalf1x16(pos.z), 0},
+      normal{packNormal(norm)},
+      texCoords{packUnorm16(tex.x), packUnorm16(tex.y)}
+  {
+  }
+
+  // Signed normalized 10 bits per component, w unused
+  static uint32_t packNormal(const glm::vec3 &n)
+  {
+    const auto pack = [](float x) {
+      return uint32_t(int32_t(std::round(glm::clamp(x, -1.f, 1.f) * 511.f)) &
+                      0x3ff);
+    };
+    return pack(n.x) | pack(n.y) << 10 | pack(n.z) << 20;
+  }
+
+  static uint16_t packUnorm16(float x)
+  {
+    return uint16_t(std::round(glm::clamp(x, 0.f, 1.f) * 65535.f));
+  }
+
+  // Formats of the attributes in the bound vertex array, read from binding
+  static void setAttribFormats(
+      GLuint vPos, GLuint vNorm, GLuint vTex, GLuint binding)
+  {
+    glEnableVertexAttribArray(vPos);
+    glEnableVertexAttribArray(vNorm);
+    glEnableVertexAttribArray(vTex);
+    glVertexAttribFormat(vPos, 3, GL_HALF_FLOAT, GL_FALSE,
+        GLuint(offsetof(PackedVertex, position)));
+    // Packed formats are always read with 4 components
+    glVertexAttribFormat(vNorm, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+        GLuint(offsetof(PackedVertex, normal)));
+    glVertexAttribFormat(vTex, 2, GL_UNSIGNED_SHORT, GL_TRUE,
+        GLuint(offsetof(PackedVertex, texCoords)));
+    for (const auto location : {vPos, vNorm, vTex}) {
+      glVertexAttribBinding(location, binding);
+    }
+  }
+
+  uint16_t position[4]; // xyz, the last one pads to 4 bytes
+  uint32_t normal;
+  uint16_t texCoords[2];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay packed");
@@ -0,0 +1,147 @@
+#include "programCache.hpp"
+#include "hash.hpp"
+#include "mappedFile.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+struct ProgramCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t binaryFormat;
+  uint32_t size; // Of the binary, which follows the header
+};
+
+const char programCacheMagic[4] = {'P', 'G', 'P', 'R'};
+
+fs::path getDirectory(const fs::path &directory)
+{
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  return formatCount > 0 ? directory : fs::path{};
+}
+
+uint64_t hashGlString(GLenum name, uint64_t hash)
+{
+  const auto str = reinterpret_cast<const char *>(glGetString(name));
+  return hashString(str ? str : "", hash);
+}
+} // namespace
+
+ProgramCache::ProgramCache(const fs::path &directory) :
+    m_Directory{getDirectory(directory)}
+{
+  m_DriverKey = hashGlString(GL_VENDOR, hashSeed);
+  m_DriverKey = hashGlString(GL_RENDERER, m_DriverKey);
+  m_DriverKey = hashGlString(GL_VERSION, m_DriverKey);
+}
+
+GLProgram ProgramCache::load(const std::vector<fs::path> &shaderPaths,
+    const std::vector<std::string> &defines)
+{
+  if (!isEnabled()) {
+    return compileProgram(shaderPaths, false, defines);
+  }
+  const auto key = getKey(shaderPaths, defines);
+  GLProgram program;
+  if (loadBinary(key, program)) {
+    return program;
+  }
+  program = compileProgram(shaderPaths, true, defines);
+  storeBinary(key, program);
+  return program;
+}
+
+uint64_t ProgramCache::getKey(const std::vector<fs::path> &shaderPaths,
+    const std::vector<std::string> &defines) const
+{
+  // The file names give the shader types
+  auto key = m_DriverKey;
+  for (const auto &shaderPath : shaderPaths) {
+    key = hashString(shaderPath.filename().string(), key);
+    key = hashString(loadShaderSource(shaderPath, defines), key);
+  }
+  return key;
+}
+
+fs::path ProgramCache::getPath(uint64_t key) const
+{
+  return m_Directory / (toHexString(key) + ".pgprog");
+}
+
+bool ProgramCache::loadBinary(uint64_t key, GLProgram &program)
+{
+  if (!isEnabled()) {
+    return false;
+  }
+  const auto path = getPath(key);
+  MappedFile file;
+  ProgramCacheHeader header;
+  if (!file.open(path) || file.size() < sizeof(header)) {
+    ++m_MissCount;
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, programCacheMagic, sizeof(header.magic)) ||
+      header.version != programCacheVersion || header.key != key ||
+      header.size != file.size() - sizeof(header)) {
+    ++m_MissCount;
+    return false;
+  }
+  glProgramBinary(program.glId(), header.binaryFormat,
+      file.data() + sizeof(header), GLsizei(header.size));
+  if (!program.getLinkStatus()) {
+    std::clog << "Program binary " << path << " rejected, recompiling"
+              << std::endl;
+    ++m_MissCount;
+    return false;
+  }
+  ++m_HitCount;
+  return true;
+}
+
+void ProgramCache::storeBinary(uint64_t key, const GLProgram &program)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  const auto path = getPath(key);
+  GLint size = 0;
+  glGetProgramiv(program.glId(), GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+  ProgramCacheHeader header{};
+  std::memcpy(header.magic, programCacheMagic, sizeof(header.magic));
+  header.version = programCacheVersion;
+  header.key = key;
+  header.size = uint32_t(size);
+  std::vector<char> binary(size);
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(
+      program.glId(), size, nullptr, &binaryFormat, binary.data());
+  header.binaryFormat = binaryFormat;
+
+  // Through a temporary file, like the scene cache
+  std::error_code error;
+  fs::create_directories(m_Directory, error);
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  std::ofstream out{tmpPath, std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(binary.data(), std::streamsize(binary.size()));
+  out.close();
+  if (!out) {
+    std::cerr << "Unable to write program cache " << tmpPath << std::endl;
+    fs::remove(tmpPath, error);
+    return;
+  }
+  fs::rename(tmpPath, path, error);
+  if (error) {
+    fs::remove(tmpPath, error);
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "shaders.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linked programs stored with glGetProgramBinary, in files named after the
+// hash of their shader sources and of the GL vendor, renderer and version. A
+// cache hit skips compiling and linking, a driver update or a source change
+// only changes the key. Binaries the driver rejects anyway are recompiled and
+// stored again.
+constexpr uint32_t programCacheVersion = 2;
+
+class ProgramCache
+{
+public:
+  // An empty directory disables the cache. Needs a GL context.
+  explicit ProgramCache(const fs::path &directory);
+
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+
+  bool isEnabled() const { return !m_Directory.empty(); }
+
+  // Same as compileProgram, from the cache when possible
+  GLProgram load(const std::vector<fs::path> &shaderPaths,
+      const std::vector<std::string> &defines = {});
+
+  // For programs linked elsewhere, see ShaderPermutations. The key depends
+  // on the sources with their defines. loadBinary counts the hits and misses.
+  uint64_t getKey(const std::vector<fs::path> &shaderPaths,
+      const std::vector<std::string> &defines) const;
+  bool loadBinary(uint64_t key, GLProgram &program);
+  void storeBinary(uint64_t key, const GLProgram &program);
+
+  uint32_t getHitCount() const { return m_HitCount; }
+  uint32_t getMissCount() const { return m_MissCount; }
+
+private:
+  fs::path getPath(uint64_t key) const;
+
+  const fs::path m_Directory; // Empty if the driver has no binary format
+  uint64_t m_DriverKey = 0;
+  uint32_t m_HitCount = 0;
+  uint32_t m_MissCount = 0;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "geometryRegistry.hpp"
 #include "glad/glad.h"
-#include "uniformHandler.hpp"
+#include "packedVertex.hpp"
+#include "uniformBuffers.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec2.hpp>
@@ -10,130 +12,64 @@
 #include <vector>
 
 // Represents a single vertex of a quad
-struct QuadVertex
-{
-
-  QuadVertex(
-      const glm::vec3 &pos, const glm::vec3 &norm, const glm::vec2 &tex) :
-      position{pos}, normal{norm}, texCoords{tex}
-  {
-  }
-
-  static unsigned long sizeOfVertex()
-  {
-    return sizeof(position) + sizeof(normal) + sizeof(texCoords);
-  }
-
-  glm::vec3 position;  // Vertex position
-  glm::vec3 normal;    // Normal vector
-  glm::vec2 texCoords; // Texture coordinates
-};
+using QuadVertex = PackedVertex;
 
 // Represents a discretized quad (rectangle) in local space.
 // Its default plane lies on the XZ plane, centered at (0, 0, 0) in local
-// coordinates. The quad has texture coordinates and normal vectors.
+// coordinates. The quad has texture coordinates and normal vectors, its 4
+// vertices are drawn with 6 indices from a GeometryRegistry.
 class QuadCustom
 {
 public:
-  // Constructor: Allocates data and builds the vertex attributes.
-  QuadCustom(GLfloat width, GLfloat height) : m_nVertexCount(0)
+  QuadCustom(GeometryRegistry &geometry, GLfloat width, GLfloat height) :
+      m_Geometry{geometry}, m_Mesh{build(geometry, width, height)}
   {
-    build(width, height); // Build method (implementation in the .cpp)
-    initObj(0, 1, 2);
   }
 
-  // Returns a pointer to the data
-  const QuadVertex *getDataPointer() const { return &m_Vertices[0]; }
-
-  // Returns the number of vertices
-  GLsizei getVertexCount() const { return m_nVertexCount; }
-
-  const unsigned long getVertexSize() const
+  // The quad gets a slot in objects on its first draw, later draws only
+  // update its model matrix when it changed
+  void draw(GLStateCache &state, const glm::mat4 &modelMatrix,
+      ObjectUniformBuffer &objects)
   {
-    return QuadVertex::sizeOfVertex();
-  }
-
-  void draw(const glm::mat4 &modelMatrix, const glm::mat4 &viewMatrix,
-      const glm::mat4 &projMatrix, const UniformHandler &handler)
-  {
-    const auto mvMatrix = viewMatrix * modelMatrix;
-    const auto mvpMatrix = projMatrix * mvMatrix;
-    const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-    glUniformMatrix4fv(
-        handler.uModelViewProjMatrix, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glUniformMatrix4fv(
-        handler.uModelViewMatrix, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-    glUniformMatrix4fv(
-        handler.uNormalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, getVertexCount());
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (!m_HasSlot) {
+      m_ObjectSlot = objects.add(modelMatrix);
+      m_HasSlot = true;
+    } else if (modelMatrix != m_ModelMatrix) {
+      objects.set(m_ObjectSlot, modelMatrix);
+    }
+    m_ModelMatrix = modelMatrix;
+    objects.bind(m_ObjectSlot);
+    m_Geometry.bind(state);
+    m_Geometry.draw(m_Mesh);
   }
 
 private:
   // Builds the quad data
-  void build(GLfloat width, GLfloat height)
+  static GeometryHandle build(
+      GeometryRegistry &geometry, GLfloat width, GLfloat height)
   {
     GLfloat halfWidth = width / 2.f;
     GLfloat halfHeight = height / 2.f;
 
     // Define the vertices for a quad (two triangles forming a rectangle)
-    QuadVertex vertices[] = {
+    const QuadVertex vertices[] = {
         {{-halfWidth, 0.f, -halfHeight}, {0.f, 1.f, 0.f},
             {0.f, 0.f}}, // Bottom-left
         {{halfWidth, 0.f, -halfHeight}, {0.f, 1.f, 0.f},
             {1.f, 0.f}}, // Bottom-right
         {{halfWidth, 0.f, halfHeight}, {0.f, 1.f, 0.f},
             {1.f, 1.f}}, // Top-right
-
-        {{-halfWidth, 0.f, -halfHeight}, {0.f, 1.f, 0.f},
-            {0.f, 0.f}}, // Bottom-left
-        {{halfWidth, 0.f, halfHeight}, {0.f, 1.f, 0.f},
-            {1.f, 1.f}}, // Top-right
         {{-halfWidth, 0.f, halfHeight}, {0.f, 1.f, 0.f}, {0.f, 1.f}} // Top-left
     };
-
-    m_Vertices.assign(vertices, vertices + 6); // Add all vertices to the vector
-    m_nVertexCount = 6; // Two triangles (6 vertices total)
-  }
-
-  // Initializes VAO pointers for position, normal, and texture coordinates
-  void initVaoPointer(GLuint vPos, GLuint vNorm, GLuint vTex)
-  {
-    std::cout << "quad vao init" << std::endl;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glEnableVertexAttribArray(vPos);
-    glEnableVertexAttribArray(vNorm);
-    glEnableVertexAttribArray(vTex);
-    glVertexAttribPointer(vPos, 3, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(QuadVertex, position));
-    glVertexAttribPointer(vNorm, 3, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(QuadVertex, normal));
-    glVertexAttribPointer(vTex, 2, GL_FLOAT, GL_FALSE, getVertexSize(),
-        (GLvoid *)offsetof(QuadVertex, texCoords));
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Bottom-left, bottom-right, top-right and bottom-left, top-right,
+    // top-left
+    const uint16_t indices[] = {0, 1, 2, 0, 2, 3};
+    return geometry.add(vertices, 4, indices, 6);
   }
 
-  void initVboPointer()
-  {
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, getVertexCount() * getVertexSize(),
-        getDataPointer(), GL_STATIC_DRAW);
-  }
-
-  void initObj(GLuint vPos, GLuint vNorm, GLuint vTex)
-  {
-    initVboPointer();
-    initVaoPointer(vPos, vNorm, vTex);
-  }
-
-  std::vector<QuadVertex> m_Vertices;
-  GLsizei m_nVertexCount; // Number of vertices
-  GLuint vbo;
-  GLuint vao;
-};
\ No newline at end of file
+  GeometryRegistry &m_Geometry;
+  GeometryHandle m_Mesh;
+  glm::mat4 m_ModelMatrix;
+  uint32_t m_ObjectSlot = 0;
+  bool m_HasSlot = false;
+};
@@ -0,0 +1,412 @@
+#include "sceneCache.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace
+{
+enum SceneCacheSection : uint32_t
+{
+  LayoutsSection,
+  StreamsSection,
+  PrimitivesSection,
+  MeshesSection,
+  MaterialsSection,
+  TexturesSection,
+  NodesSection,
+  ChildrenSection,
+  RootsSection,
+  WorldMatricesSection,
+  MeshNodesSection,
+  ImagesSection,
+  DependenciesSection,
+  UrisSection,
+  ArenaSection,
+  SectionCount
+};
+
+struct SectionRange
+{
+  uint64_t offset, size;
+};
+
+struct SceneCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint64_t fileSize;
+  SectionRange sections[SectionCount];
+};
+
+const char sceneCacheMagic[4] = {'P', 'G', 'S', 'C'};
+
+struct CachedLayout
+{
+  uint32_t firstStream, streamCount;
+  uint32_t vertexCount, padding;
+};
+
+struct CachedStream
+{
+  VertexAttribFormat format;
+  uint64_t offset;
+  uint32_t stride, padding;
+};
+
+struct CachedDependency
+{
+  uint64_t size;
+  int64_t modificationTime;
+  uint32_t uriOffset, uriSize; // In UrisSection
+};
+
+// Large blobs start on a page, so that they can be uploaded straight from
+// the mapping
+constexpr uint64_t blobAlignment = 4096;
+constexpr uint64_t sectionAlignment = 16;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+bool getDependency(
+    const fs::path &path, const std::string &uri, SceneDependency &dependency)
+{
+  std::error_code error;
+  dependency.uri = uri;
+  dependency.size = fs::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  dependency.modificationTime =
+      fs::last_write_time(path, error).time_since_epoch().count();
+  return !error;
+}
+
+template <typename T>
+bool readSection(const MappedFile &file, const SceneCacheHeader &header,
+    SceneCacheSection section, std::vector<T> &out)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "Stored as is");
+  const auto &range = header.sections[section];
+  if (range.size % sizeof(T) != 0) {
+    return false;
+  }
+  out.resize(range.size / sizeof(T));
+  if (range.size) {
+    std::memcpy(out.data(), file.data() + range.offset, range.size);
+  }
+  return true;
+}
+
+// size bytes at offset are in the arena, without overflowing
+bool isInArena(const SceneData &scene, uint64_t offset, uint64_t size)
+{
+  return offset <= scene.arenaSize && size <= scene.arenaSize - offset;
+}
+
+// Vertex streams of layout are in the arena, a stride holding an element
+bool isValid(const SceneData &scene, const VertexLayout &layout)
+{
+  for (size_t i = 0; i < layout.attributes.size(); ++i) {
+    const auto &format = layout.attributes[i];
+    const auto componentSize =
+        tinygltf::GetComponentSizeInBytes(format.componentType);
+    const auto stride = layout.streamStrides[i];
+    if (componentSize <= 0 || format.componentCount < 1 ||
+        format.componentCount > 4 ||
+        format.componentCount * uint32_t(componentSize) > stride ||
+        !isInArena(scene, layout.streamOffsets[i],
+            uint64_t(stride) * layout.vertexCount)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Vertices of primitive are in its layout, its indices in the arena
+bool isValid(const SceneData &scene, const PrimitiveDraw &primitive)
+{
+  if (primitive.layout >= scene.layouts.size() ||
+      primitive.material >= int32_t(scene.materials.size()) ||
+      primitive.baseVertex < 0) {
+    return false;
+  }
+  const auto vertexCount = scene.layouts[primitive.layout].vertexCount;
+  const auto baseVertex = uint64_t(primitive.baseVertex);
+  if (!primitive.indexType) {
+    return baseVertex + primitive.count <= vertexCount;
+  }
+  const auto indexSize =
+      primitive.indexType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ? 4 : 2;
+  return (primitive.indexType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+             primitive.indexType ==
+                 TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) &&
+         baseVertex + primitive.vertexCount <= vertexCount &&
+         isInArena(scene, primitive.indexOffset,
+             uint64_t(indexSize) * primitive.count);
+}
+
+bool isValid(const SceneData &scene)
+{
+  const auto nodeCount = scene.nodes.size();
+  const auto isNode = [&](uint32_t node) { return node < nodeCount; };
+  return std::all_of(begin(scene.layouts), end(scene.layouts),
+             [&](const VertexLayout &layout) {
+               return isValid(scene, layout);
+             }) &&
+         std::all_of(begin(scene.primitives), end(scene.primitives),
+             [&](const PrimitiveDraw &primitive) {
+               return isValid(scene, primitive);
+             }) &&
+         std::all_of(begin(scene.meshes), end(scene.meshes),
+             [&](const MeshRange &mesh) {
+               return uint64_t(mesh.firstPrimitive) + mesh.primitiveCount <=
+                      scene.primitives.size();
+             }) &&
+         std::all_of(begin(scene.materials), end(scene.materials),
+             [&](const MaterialData &material) {
+               return material.baseColorTexture <
+                          int32_t(scene.textures.size()) &&
+                      material.normalTexture < int32_t(scene.textures.size());
+             }) &&
+         std::all_of(begin(scene.textures), end(scene.textures),
+             [&](const TextureData &texture) {
+               return texture.image < int32_t(scene.imageCount);
+             }) &&
+         std::all_of(begin(scene.nodes), end(scene.nodes),
+             [&](const SceneNode &node) {
+               return node.mesh < int32_t(scene.meshes.size()) &&
+                      uint64_t(node.firstChild) + node.childCount <=
+                          scene.children.size();
+             }) &&
+         std::all_of(begin(scene.children), end(scene.children), isNode) &&
+         std::all_of(begin(scene.roots), end(scene.roots), isNode) &&
+         std::all_of(begin(scene.meshNodes), end(scene.meshNodes), isNode) &&
+         scene.worldMatrices.size() == nodeCount;
+}
+} // namespace
+
+fs::path getSceneCachePath(const fs::path &cacheDirectory, uint64_t sourceHash)
+{
+  return cacheDirectory / (toHexString(sourceHash) + ".pgscene");
+}
+
+std::vector<SceneDependency> getSceneDependencies(
+    const tinygltf::Model &model, const fs::path &sourceDirectory)
+{
+  std::vector<std::string> uris;
+  for (const auto &buffer : model.buffers) {
+    uris.push_back(buffer.uri);
+  }
+  for (const auto &image : model.images) {
+    uris.push_back(image.uri);
+  }
+  std::vector<SceneDependency> dependencies;
+  for (const auto &uri : uris) {
+    // Embedded data is covered by the hash of the glTF file
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+      continue;
+    }
+    SceneDependency dependency;
+    if (getDependency(sourceDirectory / uri, uri, dependency)) {
+      dependencies.push_back(dependency);
+    }
+  }
+  return dependencies;
+}
+
+bool writeSceneCache(const fs::path &path, uint64_t sourceHash,
+    const SceneData &scene, const ArenaReader &readArena,
+    const std::vector<SceneCacheImage> &images,
+    const std::vector<SceneDependency> &dependencies)
+{
+  std::error_code error;
+  fs::create_directories(path.parent_path(), error);
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  std::ofstream out{tmpPath, std::ios::binary | std::ios::trunc};
+  if (!out) {
+    std::cerr << "Unable to write scene cache " << tmpPath << std::endl;
+    return false;
+  }
+
+  SceneCacheHeader header{};
+  std::memcpy(header.magic, sceneCacheMagic, sizeof(header.magic));
+  header.version = sceneCacheVersion;
+  header.sourceHash = sourceHash;
+  uint64_t offset = sizeof(header);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const auto pad = [&](uint64_t alignment) {
+    static const char zeros[blobAlignment] = {};
+    const auto start = alignUp(offset, alignment);
+    out.write(zeros, std::streamsize(start - offset));
+    offset = start;
+  };
+  const auto writeRange = [&](SceneCacheSection section, const void *data,
+                              uint64_t size, uint64_t alignment) {
+    pad(alignment);
+    out.write(static_cast<const char *>(data), std::streamsize(size));
+    header.sections[section] = {offset, size};
+    offset += size;
+  };
+  const auto writeSection = [&](SceneCacheSection section, const auto &data) {
+    using T = typename std::decay_t<decltype(data)>::value_type;
+    static_assert(std::is_trivially_copyable<T>::value, "Stored as is");
+    writeRange(
+        section, data.data(), data.size() * sizeof(T), sectionAlignment);
+  };
+
+  std::vector<CachedLayout> layouts;
+  std::vector<CachedStream> streams;
+  for (const auto &layout : scene.layouts) {
+    layouts.push_back({uint32_t(streams.size()),
+        uint32_t(layout.attributes.size()), layout.vertexCount, 0});
+    for (size_t i = 0; i < layout.attributes.size(); ++i) {
+      streams.push_back({layout.attributes[i], layout.streamOffsets[i],
+          layout.streamStrides[i], 0});
+    }
+  }
+  std::vector<CachedDependency> cachedDependencies;
+  std::string uris;
+  for (const auto &dependency : dependencies) {
+    cachedDependencies.push_back({dependency.size,
+        dependency.modificationTime, uint32_t(uris.size()),
+        uint32_t(dependency.uri.size())});
+    uris += dependency.uri;
+  }
+
+  writeSection(LayoutsSection, layouts);
+  writeSection(StreamsSection, streams);
+  writeSection(PrimitivesSection, scene.primitives);
+  writeSection(MeshesSection, scene.meshes);
+  writeSection(MaterialsSection, scene.materials);
+  writeSection(TexturesSection, scene.textures);
+  writeSection(NodesSection, scene.nodes);
+  writeSection(ChildrenSection, scene.children);
+  writeSection(RootsSection, scene.roots);
+  writeSection(WorldMatricesSection, scene.worldMatrices);
+  writeSection(MeshNodesSection, scene.meshNodes);
+  writeSection(ImagesSection, images);
+  writeSection(DependenciesSection, cachedDependencies);
+  writeSection(UrisSection, uris);
+
+  // The arena is streamed through a small buffer, it is never whole in memory
+  pad(blobAlignment);
+  header.sections[ArenaSection] = {offset, scene.arenaSize};
+  std::vector<char> chunk(
+      size_t(std::min<uint64_t>(scene.arenaSize, 1024 * 1024)));
+  for (uint64_t done = 0; done < scene.arenaSize;) {
+    const auto size = std::min<uint64_t>(chunk.size(), scene.arenaSize - done);
+    readArena(done, size, chunk.data());
+    out.write(chunk.data(), std::streamsize(size));
+    done += size;
+  }
+  offset += scene.arenaSize;
+  pad(sectionAlignment);
+  header.fileSize = offset;
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+  if (!out) {
+    std::cerr << "Unable to write scene cache " << tmpPath << std::endl;
+    fs::remove(tmpPath, error);
+    return false;
+  }
+  fs::rename(tmpPath, path, error);
+  if (error) {
+    std::cerr << "Unable to write scene cache " << path << ": "
+              << error.message() << std::endl;
+    fs::remove(tmpPath, error);
+    return false;
+  }
+  return true;
+}
+
+bool readSceneCache(const MappedFile &file, uint64_t sourceHash,
+    const fs::path &sourceDirectory, SceneData &scene,
+    const unsigned char *&arena, std::vector<SceneCacheImage> &images)
+{
+  SceneCacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, sceneCacheMagic, sizeof(header.magic)) != 0 ||
+      header.version != sceneCacheVersion ||
+      header.sourceHash != sourceHash || header.fileSize != file.size()) {
+    return false;
+  }
+  for (const auto &range : header.sections) {
+    if (range.offset > file.size() || range.size > file.size() - range.offset) {
+      return false;
+    }
+  }
+
+  std::vector<CachedDependency> dependencies;
+  std::vector<char> uris;
+  if (!readSection(file, header, DependenciesSection, dependencies) ||
+      !readSection(file, header, UrisSection, uris)) {
+    return false;
+  }
+  for (const auto &cached : dependencies) {
+    if (uint64_t(cached.uriOffset) + cached.uriSize > uris.size()) {
+      return false;
+    }
+    const std::string uri{uris.data() + cached.uriOffset, cached.uriSize};
+    SceneDependency dependency;
+    if (!getDependency(sourceDirectory / uri, uri, dependency) ||
+        dependency.size != cached.size ||
+        dependency.modificationTime != cached.modificationTime) {
+      return false; // Stale
+    }
+  }
+
+  scene = SceneData{};
+  std::vector<CachedLayout> layouts;
+  std::vector<CachedStream> streams;
+  if (!readSection(file, header, LayoutsSection, layouts) ||
+      !readSection(file, header, StreamsSection, streams) ||
+      !readSection(file, header, PrimitivesSection, scene.primitives) ||
+      !readSection(file, header, MeshesSection, scene.meshes) ||
+      !readSection(file, header, MaterialsSection, scene.materials) ||
+      !readSection(file, header, TexturesSection, scene.textures) ||
+      !readSection(file, header, NodesSection, scene.nodes) ||
+      !readSection(file, header, ChildrenSection, scene.children) ||
+      !readSection(file, header, RootsSection, scene.roots) ||
+      !readSection(file, header, WorldMatricesSection, scene.worldMatrices) ||
+      !readSection(file, header, MeshNodesSection, scene.meshNodes) ||
+      !readSection(file, header, ImagesSection, images)) {
+    return false;
+  }
+  for (const auto &cached : layouts) {
+    if (uint64_t(cached.firstStream) + cached.streamCount > streams.size()) {
+      return false;
+    }
+    VertexLayout layout;
+    for (uint32_t i = 0; i < cached.streamCount; ++i) {
+      const auto &stream = streams[cached.firstStream + i];
+      layout.attributes.push_back(stream.format);
+      layout.streamOffsets.push_back(stream.offset);
+      layout.streamStrides.push_back(stream.stride);
+    }
+    layout.vertexCount = cached.vertexCount;
+    scene.layouts.push_back(std::move(layout));
+  }
+  const auto &arenaRange = header.sections[ArenaSection];
+  scene.imageCount = uint32_t(images.size());
+  scene.arenaSize = arenaRange.size;
+  if (!isValid(scene)) {
+    return false;
+  }
+
+  arena = file.data() + arenaRange.offset;
+  return true;
+}
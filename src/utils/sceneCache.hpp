@@ -0,0 +1,55 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "mappedFile.hpp"
+#include "sceneData.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// File read by a glTF file besides itself (.bin buffers, images...). The
+// cache is keyed by the hash of the glTF file only, so these are checked by
+// size and modification time.
+struct SceneDependency
+{
+  std::string uri; // Relative to the glTF file
+  uint64_t size;
+  int64_t modificationTime;
+};
+
+// Image of a cached scene, whose mip chain is in the texture cache under
+// textureKey (see decodeTexture), so that it isn't stored twice
+struct SceneCacheImage
+{
+  uint64_t textureKey;
+  uint32_t decoded; // 0 if the image couldn't be decoded, it has no file
+  uint32_t padding;
+};
+
+// Cooked scene files, written after a glTF file is loaded and mapped as is on
+// later loads: the SceneData, the arena and the texture cache keys of the
+// images, in the native layout of the structures. Files are named after a
+// key hashed from the glTF file and the cooking options (see
+// AsyncSceneLoader), a cache hit skips parsing, decoding and cooking
+// altogether.
+constexpr uint32_t sceneCacheVersion = 7;
+
+fs::path getSceneCachePath(const fs::path &cacheDirectory, uint64_t sourceHash);
+
+std::vector<SceneDependency> getSceneDependencies(
+    const tinygltf::Model &model, const fs::path &sourceDirectory);
+
+// Writes a temporary file then renames it, so that a cache file is either
+// complete or absent. Returns false on failure, with a message.
+bool writeSceneCache(const fs::path &path, uint64_t sourceHash,
+    const SceneData &scene, const ArenaReader &readArena,
+    const std::vector<SceneCacheImage> &images,
+    const std::vector<SceneDependency> &dependencies);
+
+// Fills scene and images, and arena with a pointer into file. Returns false if
+// the file isn't a valid cache of this version for sourceHash, or if one of
+// its dependencies changed.
+bool readSceneCache(const MappedFile &file, uint64_t sourceHash,
+    const fs::path &sourceDirectory, SceneData &scene,
+    const unsigned char *&arena, std::vector<SceneCacheImage> &images);
@@ -0,0 +1,750 @@
+#include "sceneData.hpp"
+#include "boundsKernels.hpp"
+#include "gltf.hpp"
+#include "meshOptimizer.hpp"
+#include "tangents.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+// Attributes used by the forward shaders, in location order
+const std::pair<const char *, uint32_t> usedAttributes[] = {
+    {"POSITION", PositionLocation}, {"NORMAL", NormalLocation},
+    {"TEXCOORD_0", TexCoord0Location}, {"TANGENT", TangentLocation}};
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t getElementSize(uint32_t componentCount, uint32_t componentType)
+{
+  return componentCount * tinygltf::GetComponentSizeInBytes(componentType);
+}
+
+uint32_t getElementSize(const tinygltf::Accessor &accessor)
+{
+  return getElementSize(tinygltf::GetNumComponentsInType(accessor.type),
+      accessor.componentType);
+}
+
+size_t getAccessorStride(
+    const tinygltf::Model &model, const tinygltf::Accessor &accessor)
+{
+  const auto stride =
+      accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+  return stride > 0 ? size_t(stride) : getElementSize(accessor);
+}
+
+// Buffers may be mapped files, so every element must be inside its buffer
+bool isReadable(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, const tinygltf::Accessor &accessor)
+{
+  if (accessor.bufferView < 0 || accessor.sparse.isSparse) {
+    return false;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  if (bufferView.buffer < 0 || size_t(bufferView.buffer) >= buffers.size()) {
+    return false;
+  }
+  const uint64_t viewEnd = uint64_t(bufferView.byteOffset) +
+                           bufferView.byteLength;
+  const uint64_t accessorEnd =
+      accessor.count ? uint64_t(accessor.byteOffset) +
+                           (accessor.count - 1) *
+                               getAccessorStride(model, accessor) +
+                           getElementSize(accessor)
+                     : 0;
+  // Elements are staged in 16 bytes by writeSceneArena
+  return viewEnd <= buffers[bufferView.buffer].size &&
+         accessorEnd <= bufferView.byteLength &&
+         getElementSize(accessor) <= 16;
+}
+
+const unsigned char *getAccessorData(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, const tinygltf::Accessor &accessor)
+{
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  return buffers[bufferView.buffer].data + bufferView.byteOffset +
+         accessor.byteOffset;
+}
+
+// Position formats of glTF, with KHR_mesh_quantization for the integer ones
+bool isPositionFormat(const tinygltf::Accessor &accessor)
+{
+  switch (accessor.componentType) {
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return accessor.type == TINYGLTF_TYPE_VEC3;
+  default:
+    return false;
+  }
+}
+
+// Component as the vertex fetch converts it to float
+float readComponent(
+    const unsigned char *src, uint32_t componentType, bool normalized)
+{
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE: {
+    const auto value = float(int8_t(*src));
+    return normalized ? std::max(value / 127.f, -1.f) : value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return normalized ? *src / 255.f : *src;
+  case TINYGLTF_COMPONENT_TYPE_SHORT: {
+    int16_t value;
+    std::memcpy(&value, src, sizeof(value));
+    return normalized ? std::max(value / 32767.f, -1.f) : value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t value;
+    std::memcpy(&value, src, sizeof(value));
+    return normalized ? value / 65535.f : value;
+  }
+  default: {
+    float value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+  }
+  }
+}
+
+// Positions of an accessor of isPositionFormat, decoded to float
+void readPositions(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, const tinygltf::Accessor &accessor,
+    size_t first, size_t count, glm::vec3 *positions)
+{
+  const auto data = getAccessorData(model, buffers, accessor);
+  const auto stride = getAccessorStride(model, accessor);
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  for (size_t i = 0; i < count; ++i) {
+    const auto element = data + (first + i) * stride;
+    for (int c = 0; c < 3; ++c) {
+      positions[i][c] = readComponent(element + c * componentSize,
+          accessor.componentType, accessor.normalized);
+    }
+  }
+}
+
+// Unsigned integer of size bytes, for indices
+uint32_t readUnsigned(const unsigned char *src, uint32_t size)
+{
+  if (size == 1) {
+    return *src;
+  }
+  if (size == 2) {
+    uint16_t value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+  }
+  uint32_t value;
+  std::memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+void writeUnsigned(unsigned char *dst, uint32_t size, uint32_t value)
+{
+  if (size == 2) {
+    const auto narrow = uint16_t(value);
+    std::memcpy(dst, &narrow, sizeof(narrow));
+  } else {
+    std::memcpy(dst, &value, sizeof(value));
+  }
+}
+
+} // namespace
+
+std::vector<kln::Aabb> computePositionBounds(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers,
+    const std::vector<int32_t> &accessors, ThreadPool *pool)
+{
+  std::vector<kln::Aabb> bounds(accessors.size());
+  // Accessors to scan are cut in chunks, so that a single large mesh is
+  // spread over the pool too
+  struct Chunk
+  {
+    size_t bounds;
+    size_t first, count;
+  };
+  constexpr size_t chunkSize = 256 * 1024;
+  std::vector<Chunk> chunks;
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    const auto &accessor = model.accessors[accessors[i]];
+    // Quantized positions are always scanned, their min/max aren't in the
+    // units of the vertex shader when they are normalized
+    const auto isFloat =
+        accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT;
+    if (isFloat && accessor.minValues.size() == 3 &&
+        accessor.maxValues.size() == 3) {
+      bounds[i].min = glm::vec3(accessor.minValues[0], accessor.minValues[1],
+          accessor.minValues[2]);
+      bounds[i].max = glm::vec3(accessor.maxValues[0], accessor.maxValues[1],
+          accessor.maxValues[2]);
+      continue;
+    }
+    // min and max are required by the spec, but some exporters forget them
+    if (!isPositionFormat(accessor) || !isReadable(model, buffers, accessor)) {
+      continue;
+    }
+    for (size_t first = 0; first < accessor.count; first += chunkSize) {
+      chunks.push_back({i, first, std::min(chunkSize, accessor.count - first)});
+    }
+  }
+
+  std::vector<kln::Aabb> chunkBounds(chunks.size());
+  const auto scanChunk = [&](size_t i) {
+    const auto &chunk = chunks[i];
+    const auto &accessor = model.accessors[accessors[chunk.bounds]];
+    const auto stride = getAccessorStride(model, accessor);
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      chunkBounds[i] = kln::scanPositionBounds(
+          getAccessorData(model, buffers, accessor) + chunk.first * stride,
+          stride, chunk.count);
+      return;
+    }
+    std::vector<glm::vec3> positions(chunk.count);
+    readPositions(
+        model, buffers, accessor, chunk.first, chunk.count, positions.data());
+    chunkBounds[i] = kln::scanPositionBounds(
+        reinterpret_cast<const unsigned char *>(positions.data()),
+        sizeof(glm::vec3), chunk.count);
+  };
+  if (pool) {
+    pool->parallelFor(chunks.size(), scanChunk);
+  } else {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      scanChunk(i);
+    }
+  }
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    bounds[chunks[i].bounds].grow(chunkBounds[i]);
+  }
+  return bounds;
+}
+
+std::vector<BufferData> getBufferData(const tinygltf::Model &model)
+{
+  std::vector<BufferData> buffers;
+  for (const auto &buffer : model.buffers) {
+    buffers.push_back({buffer.data.data(), buffer.data.size()});
+  }
+  return buffers;
+}
+
+void cookSceneData(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, SceneData &scene, ThreadPool *pool,
+    bool optimizeMeshes)
+{
+  scene = SceneData{};
+
+  // The streams of a layout can only be placed once all its primitives are
+  // known, and the vertex count of optimized primitives once they are
+  // compacted, so copies are recorded relative to the primitive first
+  struct VertexCopy
+  {
+    uint32_t primitive, stream;
+    int32_t accessor; // ArenaCopy::generatedTangents for generated tangents
+    uint32_t firstTangent;
+    uint32_t firstRemap;
+  };
+  struct IndexCopy
+  {
+    uint32_t primitive;
+    int32_t accessor; // ArenaCopy::generatedIndices if optimized
+    uint32_t firstIndex;
+  };
+  std::vector<VertexCopy> vertexCopies;
+  std::vector<IndexCopy> indexCopies;
+  std::vector<int32_t> positionAccessors; // Per primitive, for the bounds
+  struct TangentJob
+  {
+    const tinygltf::Primitive *primitive;
+    uint32_t firstTangent;
+  };
+  std::vector<TangentJob> tangentJobs;
+  uint32_t tangentCount = 0;
+  struct OptimizeJob
+  {
+    const tinygltf::Primitive *primitive;
+    uint32_t draw;
+    uint32_t firstIndex, firstRemap;
+    // Vertex cache misses per triangle, see getAverageCacheMissRatio
+    float missRatioBefore = 0.f, missRatioAfter = 0.f;
+  };
+  std::vector<OptimizeJob> optimizeJobs;
+  uint32_t generatedIndexCount = 0;
+  uint32_t remapCount = 0;
+
+  scene.meshes.reserve(model.meshes.size());
+  for (const auto &mesh : model.meshes) {
+    MeshRange range{uint32_t(scene.primitives.size()), 0};
+    for (const auto &primitive : mesh.primitives) {
+      std::vector<VertexAttribFormat> formats;
+      std::vector<int32_t> accessors;
+      for (const auto &attribute : usedAttributes) {
+        const auto it = primitive.attributes.find(attribute.first);
+        if (it == end(primitive.attributes)) {
+          continue;
+        }
+        // Tangents are only read by normal mapping
+        if (attribute.second == TangentLocation &&
+            (primitive.material < 0 ||
+                model.materials[primitive.material].normalTexture.index <
+                    0)) {
+          continue;
+        }
+        const auto &accessor = model.accessors[it->second];
+        formats.push_back({attribute.second,
+            uint32_t(tinygltf::GetNumComponentsInType(accessor.type)),
+            uint32_t(accessor.componentType), accessor.normalized});
+        accessors.push_back(it->second);
+      }
+      if (formats.empty() || formats[0].location != PositionLocation) {
+        std::cerr << "Primitive of mesh " << mesh.name
+                  << " without POSITION, skipping it." << std::endl;
+        continue;
+      }
+      // Quantized attributes are kept as they are, the vertex fetch
+      // converts them
+      const auto &positionAccessor = model.accessors[accessors[0]];
+      if (!isPositionFormat(positionAccessor)) {
+        std::cerr << "Primitive of mesh " << mesh.name
+                  << " with unsupported positions, skipping it."
+                  << std::endl;
+        continue;
+      }
+      // Normal-mapped triangles without tangents get generated ones, which
+      // needs both NORMAL and TEXCOORD_0
+      const auto mode =
+          primitive.mode >= 0 ? primitive.mode : TINYGLTF_MODE_TRIANGLES;
+      const auto generateTangents =
+          formats.size() == 3 && formats[2].location == TexCoord0Location &&
+          formats[0].componentType == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+          formats[1].componentType == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+          mode == TINYGLTF_MODE_TRIANGLES && primitive.material >= 0 &&
+          model.materials[primitive.material].normalTexture.index >= 0;
+      if (generateTangents) {
+        formats.push_back(
+            {TangentLocation, 4, TINYGLTF_COMPONENT_TYPE_FLOAT, 0});
+        accessors.push_back(ArenaCopy::generatedTangents);
+      }
+      const auto readable =
+          std::all_of(begin(accessors), end(accessors),
+              [&](int32_t idx) {
+                return idx < 0 ||
+                       isReadable(model, buffers, model.accessors[idx]);
+              }) &&
+          (primitive.indices < 0 ||
+              isReadable(model, buffers, model.accessors[primitive.indices]));
+      if (!readable) {
+        std::cerr << "Primitive of mesh " << mesh.name
+                  << " with sparse, empty or invalid accessors, skipping it."
+                  << std::endl;
+        continue;
+      }
+
+      auto layoutIt = std::find_if(begin(scene.layouts), end(scene.layouts),
+          [&](const VertexLayout &layout) {
+            return layout.attributes == formats;
+          });
+      if (layoutIt == end(scene.layouts)) {
+        scene.layouts.push_back({formats, {}, {}, 0});
+        layoutIt = end(scene.layouts) - 1;
+      }
+      const auto drawIdx = uint32_t(scene.primitives.size());
+      const auto vertexCount = uint32_t(positionAccessor.count);
+      // Optimized vertices are read through a remap, which must stay inside
+      // every attribute
+      const auto optimize =
+          optimizeMeshes && primitive.indices >= 0 &&
+          mode == TINYGLTF_MODE_TRIANGLES &&
+          std::all_of(begin(accessors), end(accessors), [&](int32_t idx) {
+            return idx < 0 || model.accessors[idx].count >= vertexCount;
+          });
+
+      PrimitiveDraw draw{};
+      draw.layout = uint32_t(layoutIt - begin(scene.layouts));
+      draw.mode = mode;
+      draw.vertexCount = vertexCount; // Until compacted
+      draw.material = primitive.material;
+      positionAccessors.push_back(accessors[0]);
+      const auto firstRemap = optimize ? remapCount : ArenaCopy::noRemap;
+      for (uint32_t i = 0; i < accessors.size(); ++i) {
+        vertexCopies.push_back(
+            {drawIdx, i, accessors[i], tangentCount, firstRemap});
+      }
+      if (generateTangents) {
+        tangentJobs.push_back({&primitive, tangentCount});
+        tangentCount += vertexCount;
+      }
+
+      if (primitive.indices >= 0) {
+        // glTF component types are the GL enums, unsigned bytes are widened.
+        // Optimized indices keep the type, they only get smaller.
+        const auto &indexAccessor = model.accessors[primitive.indices];
+        draw.indexType =
+            indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT
+                ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT
+                : TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+        draw.count = uint32_t(indexAccessor.count);
+        if (optimize) {
+          optimizeJobs.push_back(
+              {&primitive, drawIdx, generatedIndexCount, remapCount});
+          indexCopies.push_back(
+              {drawIdx, ArenaCopy::generatedIndices, generatedIndexCount});
+          generatedIndexCount += draw.count;
+          remapCount += vertexCount;
+        } else {
+          indexCopies.push_back({drawIdx, primitive.indices, 0});
+        }
+      } else {
+        draw.indexType = 0;
+        draw.count = vertexCount;
+      }
+      scene.primitives.push_back(draw);
+      ++range.primitiveCount;
+    }
+    scene.meshes.push_back(range);
+  }
+
+  const auto bounds =
+      computePositionBounds(model, buffers, positionAccessors, pool);
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    scene.primitives[i].bounds = bounds[i];
+  }
+
+  // Each primitive writes its own range of the generated data
+  const auto generated = std::make_shared<GeneratedData>();
+  generated->tangents.resize(tangentCount);
+  generated->indices.resize(generatedIndexCount);
+  generated->remaps.resize(remapCount);
+  const auto generateJob = [&](size_t i) {
+    const auto &primitive = *tangentJobs[i].primitive;
+    const auto getData = [&](int32_t accessorIdx) {
+      const auto &accessor = model.accessors[accessorIdx];
+      return StridedData{getAccessorData(model, buffers, accessor),
+          getAccessorStride(model, accessor)};
+    };
+    const auto position = primitive.attributes.at("POSITION");
+    const auto texCoord = primitive.attributes.at("TEXCOORD_0");
+    TangentInput input{getData(position),
+        getData(primitive.attributes.at("NORMAL")), getData(texCoord),
+        {nullptr, 0}, uint32_t(model.accessors[texCoord].componentType), 0,
+        uint32_t(model.accessors[position].count), 0};
+    if (primitive.indices >= 0) {
+      const auto &indexAccessor = model.accessors[primitive.indices];
+      input.indices = getData(primitive.indices);
+      input.indexType = uint32_t(indexAccessor.componentType);
+      input.indexCount = uint32_t(indexAccessor.count);
+    }
+    // Attributes may be shorter than the positions, see the vertex copies
+    for (const auto &attribute : {"NORMAL", "TEXCOORD_0"}) {
+      input.vertexCount = std::min(input.vertexCount,
+          uint32_t(model.accessors[primitive.attributes.at(attribute)].count));
+    }
+    generateTangents(
+        input, generated->tangents.data() + tangentJobs[i].firstTangent);
+  };
+  const auto optimizeJob = [&](size_t i) {
+    auto &job = optimizeJobs[i];
+    auto &draw = scene.primitives[job.draw];
+    const auto &indexAccessor = model.accessors[job.primitive->indices];
+    const auto indexData = getAccessorData(model, buffers, indexAccessor);
+    const auto indexStride = getAccessorStride(model, indexAccessor);
+    const auto indexSize = getElementSize(indexAccessor);
+    const auto indices = generated->indices.data() + job.firstIndex;
+    const auto remaps = generated->remaps.data() + job.firstRemap;
+    bool valid = true;
+    for (uint32_t j = 0; j < draw.count; ++j) {
+      indices[j] = readUnsigned(indexData + j * indexStride, indexSize);
+      valid = valid && indices[j] < draw.vertexCount;
+    }
+    if (!valid) {
+      // Invalid file, the indices are drawn as they are
+      for (uint32_t j = 0; j < draw.vertexCount; ++j) {
+        remaps[j] = j;
+      }
+      return;
+    }
+    job.missRatioBefore =
+        getAverageCacheMissRatio(indices, draw.count, draw.vertexCount);
+    const auto &positionAccessor =
+        model.accessors[job.primitive->attributes.at("POSITION")];
+    const auto clusters =
+        optimizeVertexCache(indices, draw.count, draw.vertexCount);
+    if (positionAccessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      optimizeOverdraw(indices, draw.count, clusters,
+          getAccessorData(model, buffers, positionAccessor),
+          getAccessorStride(model, positionAccessor));
+    } else {
+      std::vector<glm::vec3> positions(draw.vertexCount);
+      readPositions(model, buffers, positionAccessor, 0, positions.size(),
+          positions.data());
+      optimizeOverdraw(indices, draw.count, clusters,
+          reinterpret_cast<const unsigned char *>(positions.data()),
+          sizeof(glm::vec3));
+    }
+    std::vector<uint32_t> remap;
+    draw.vertexCount =
+        optimizeVertexFetch(indices, draw.count, draw.vertexCount, remap);
+    std::copy(begin(remap), end(remap), remaps);
+    job.missRatioAfter =
+        getAverageCacheMissRatio(indices, draw.count, draw.vertexCount);
+  };
+  if (pool) {
+    pool->parallelFor(tangentJobs.size(), generateJob);
+    pool->parallelFor(optimizeJobs.size(), optimizeJob);
+  } else {
+    for (size_t i = 0; i < tangentJobs.size(); ++i) {
+      generateJob(i);
+    }
+    for (size_t i = 0; i < optimizeJobs.size(); ++i) {
+      optimizeJob(i);
+    }
+  }
+  scene.generated = generated;
+
+  // Averaged over the triangles of the optimized primitives
+  double missesBefore = 0., missesAfter = 0., triangleCount = 0.;
+  for (const auto &job : optimizeJobs) {
+    if (job.missRatioBefore == 0.f) {
+      continue; // Invalid indices, left as they are
+    }
+    const auto triangles = double(scene.primitives[job.draw].count / 3);
+    missesBefore += job.missRatioBefore * triangles;
+    missesAfter += job.missRatioAfter * triangles;
+    triangleCount += triangles;
+  }
+  if (triangleCount > 0.) {
+    std::clog << "Vertex cache misses per triangle: "
+              << missesBefore / triangleCount << " before optimization, "
+              << missesAfter / triangleCount << " after" << std::endl;
+  }
+
+  // Primitives take their vertices in the pool of their layout
+  for (auto &draw : scene.primitives) {
+    auto &layout = scene.layouts[draw.layout];
+    draw.baseVertex = int32_t(layout.vertexCount);
+    layout.vertexCount += draw.vertexCount;
+  }
+
+  // Arena: every vertex stream, then every index
+  uint64_t offset = 0;
+  for (auto &layout : scene.layouts) {
+    for (const auto &format : layout.attributes) {
+      const auto stride = uint32_t(alignUp(
+          getElementSize(format.componentCount, format.componentType), 4));
+      layout.streamOffsets.push_back(offset);
+      layout.streamStrides.push_back(stride);
+      offset = alignUp(offset + uint64_t(stride) * layout.vertexCount, 16);
+    }
+  }
+  for (const auto &copy : vertexCopies) {
+    const auto &draw = scene.primitives[copy.primitive];
+    const auto &layout = scene.layouts[draw.layout];
+    const auto stride = layout.streamStrides[copy.stream];
+    auto elementSize = uint32_t(sizeof(glm::vec4));
+    auto count = draw.vertexCount;
+    if (copy.accessor >= 0) {
+      const auto &accessor = model.accessors[copy.accessor];
+      elementSize = getElementSize(accessor);
+      count = std::min(count, uint32_t(accessor.count));
+    }
+    scene.copies.push_back({copy.accessor,
+        layout.streamOffsets[copy.stream] +
+            uint64_t(stride) * uint32_t(draw.baseVertex),
+        stride, elementSize, count, copy.firstTangent, copy.firstRemap});
+  }
+  for (const auto &copy : indexCopies) {
+    auto &draw = scene.primitives[copy.primitive];
+    const uint32_t indexSize =
+        draw.indexType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ? 4 : 2;
+    offset = alignUp(offset, 4);
+    draw.indexOffset = offset;
+    scene.copies.push_back({copy.accessor, offset, indexSize, indexSize,
+        draw.count, copy.firstIndex, ArenaCopy::noRemap});
+    offset += uint64_t(indexSize) * draw.count;
+  }
+  scene.arenaSize = alignUp(offset, 16);
+  // For writeSceneArena to find the copies of a range
+  std::sort(begin(scene.copies), end(scene.copies),
+      [](const ArenaCopy &lhs, const ArenaCopy &rhs) {
+        return lhs.offset < rhs.offset;
+      });
+
+  for (const auto &material : model.materials) {
+    const auto &pbr = material.pbrMetallicRoughness;
+    glm::vec4 factor(1.f);
+    if (pbr.baseColorFactor.size() == 4) {
+      factor = glm::vec4(pbr.baseColorFactor[0], pbr.baseColorFactor[1],
+          pbr.baseColorFactor[2], pbr.baseColorFactor[3]);
+    }
+    scene.materials.push_back({pbr.baseColorTexture.index, factor,
+        material.normalTexture.index, float(material.normalTexture.scale)});
+  }
+
+  for (const auto &texture : model.textures) {
+    const auto linear = TINYGLTF_TEXTURE_FILTER_LINEAR;
+    TextureData data{texture.source, linear, linear,
+        TINYGLTF_TEXTURE_WRAP_REPEAT, TINYGLTF_TEXTURE_WRAP_REPEAT};
+    if (texture.sampler >= 0) {
+      const auto &sampler = model.samplers[texture.sampler];
+      data.minFilter = sampler.minFilter != -1 ? sampler.minFilter : linear;
+      data.magFilter = sampler.magFilter != -1 ? sampler.magFilter : linear;
+      data.wrapS = sampler.wrapS;
+      data.wrapT = sampler.wrapT;
+    }
+    scene.textures.push_back(data);
+  }
+  scene.imageCount = uint32_t(model.images.size());
+
+  for (const auto &node : model.nodes) {
+    scene.nodes.push_back({getLocalToWorldMatrix(node, glm::mat4(1)),
+        node.mesh, uint32_t(scene.children.size()),
+        uint32_t(node.children.size())});
+    for (const auto child : node.children) {
+      scene.children.push_back(uint32_t(child));
+    }
+  }
+  auto sceneIdx = model.defaultScene;
+  if (sceneIdx < 0 && !model.scenes.empty()) {
+    sceneIdx = 0;
+  }
+  if (sceneIdx >= 0) {
+    for (const auto nodeIdx : model.scenes[sceneIdx].nodes) {
+      scene.roots.push_back(uint32_t(nodeIdx));
+    }
+  }
+
+  // World matrices, so that the hierarchy isn't walked again to draw
+  scene.worldMatrices.assign(scene.nodes.size(), glm::mat4(1));
+  std::vector<uint32_t> stack(scene.roots.rbegin(), scene.roots.rend());
+  std::vector<bool> visited(scene.nodes.size(), false);
+  for (const auto root : scene.roots) {
+    scene.worldMatrices[root] = scene.nodes[root].localMatrix;
+  }
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back();
+    stack.pop_back();
+    if (visited[nodeIdx]) {
+      continue; // Invalid file, a node can only have one parent
+    }
+    visited[nodeIdx] = true;
+    const auto &node = scene.nodes[nodeIdx];
+    if (node.mesh >= 0) {
+      scene.meshNodes.push_back(nodeIdx);
+    }
+    for (uint32_t i = node.childCount; i-- > 0;) {
+      const auto childIdx = scene.children[node.firstChild + i];
+      scene.worldMatrices[childIdx] =
+          scene.worldMatrices[nodeIdx] * scene.nodes[childIdx].localMatrix;
+      stack.push_back(childIdx);
+    }
+  }
+}
+
+void writeSceneArena(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, const SceneData &scene,
+    uint64_t offset, uint64_t size, void *dst)
+{
+  if (!size) {
+    return;
+  }
+  const auto out = static_cast<unsigned char *>(dst);
+  const auto offsetEnd = offset + size;
+  // Padding between copies is zeroed, so that the content of the arena
+  // doesn't depend on how it is split
+  auto zeroed = offset;
+  const auto zeroUpTo = [&](uint64_t end) {
+    if (zeroed < end) {
+      std::memset(out + (zeroed - offset), 0, end - zeroed);
+      zeroed = end;
+    }
+  };
+  // Copies don't overlap, the first one to write is the last one starting
+  // before offset, or the first one
+  auto copyIt = std::upper_bound(begin(scene.copies), end(scene.copies),
+      offset, [](uint64_t value, const ArenaCopy &copy) {
+        return value < copy.offset;
+      });
+  if (copyIt != begin(scene.copies)) {
+    --copyIt;
+  }
+  for (; copyIt != end(scene.copies) && copyIt->offset < offsetEnd;
+       ++copyIt) {
+    const auto &copy = *copyIt;
+    if (copy.count == 0) {
+      continue;
+    }
+    const unsigned char *src;
+    size_t srcStride;
+    uint32_t srcSize;
+    if (copy.accessor >= 0) {
+      const auto &accessor = model.accessors[copy.accessor];
+      src = getAccessorData(model, buffers, accessor);
+      srcStride = getAccessorStride(model, accessor);
+      srcSize = getElementSize(accessor);
+    } else if (copy.accessor == ArenaCopy::generatedTangents) {
+      src = reinterpret_cast<const unsigned char *>(
+          scene.generated->tangents.data() + copy.firstGenerated);
+      srcStride = srcSize = sizeof(glm::vec4);
+    } else {
+      src = reinterpret_cast<const unsigned char *>(
+          scene.generated->indices.data() + copy.firstGenerated);
+      srcStride = srcSize = sizeof(uint32_t);
+    }
+    const auto remaps = copy.firstRemap != ArenaCopy::noRemap
+                            ? scene.generated->remaps.data() + copy.firstRemap
+                            : nullptr;
+    const auto copyEnd =
+        copy.offset + uint64_t(copy.count - 1) * copy.stride + copy.elementSize;
+    if (copyEnd <= offset) {
+      continue;
+    }
+    const auto writeBegin = std::max(offset, copy.offset);
+    const auto writeEnd = std::min(offsetEnd, copyEnd);
+    zeroUpTo(writeBegin);
+    zeroed = writeEnd;
+    if (!remaps && srcSize == copy.elementSize && srcStride == copy.stride) {
+      std::memcpy(out + (writeBegin - offset),
+          src + (writeBegin - copy.offset), writeEnd - writeBegin);
+      continue;
+    }
+    // Element by element, the range may cut the first and last ones
+    if (copy.stride != copy.elementSize) {
+      std::memset(out + (writeBegin - offset), 0, writeEnd - writeBegin);
+    }
+    const auto first = (writeBegin - copy.offset) / copy.stride;
+    const auto last = std::min<uint64_t>(copy.count,
+        (writeEnd - copy.offset + copy.stride - 1) / copy.stride);
+    for (auto i = first; i < last; ++i) {
+      unsigned char element[16];
+      const auto srcElement = src + (remaps ? remaps[i] : i) * srcStride;
+      if (srcSize != copy.elementSize) {
+        // Indices, widened from unsigned bytes or narrowed from generated
+        // unsigned ints
+        writeUnsigned(
+            element, copy.elementSize, readUnsigned(srcElement, srcSize));
+      } else {
+        std::memcpy(element, srcElement, srcSize);
+      }
+      const auto elementBegin = copy.offset + i * copy.stride;
+      const auto from = std::max(writeBegin, elementBegin);
+      const auto to = std::min(writeEnd, elementBegin + copy.elementSize);
+      if (from < to) {
+        std::memcpy(
+            out + (from - offset), element + (from - elementBegin), to - from);
+      }
+    }
+  }
+  zeroUpTo(offsetEnd);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "bvh.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <tiny_gltf.h>
+#include <vector>
+
+class ThreadPool;
+
+// Attribute locations of the forward shaders
+enum VertexAttribLocation : uint32_t
+{
+  PositionLocation = 0,
+  NormalLocation = 1,
+  TexCoord0Location = 2,
+  TangentLocation = 4, // 3 is the instance offset of the cubes, see NORMAL_MAP
+};
+
+// Format of one vertex attribute, as given to glVertexAttribFormat
+struct VertexAttribFormat
+{
+  uint32_t location;
+  uint32_t componentCount;
+  uint32_t componentType; // GL_FLOAT, GL_UNSIGNED_SHORT...
+  uint32_t normalized;
+
+  bool operator==(const VertexAttribFormat &other) const
+  {
+    return location == other.location &&
+           componentCount == other.componentCount &&
+           componentType == other.componentType &&
+           normalized == other.normalized;
+  }
+};
+
+// Primitives with the same attribute formats. Their vertices are appended to
+// one tightly packed stream per attribute, so that they can share a vertex
+// array and only differ by their base vertex.
+struct VertexLayout
+{
+  std::vector<VertexAttribFormat> attributes; // Sorted by location
+  std::vector<uint64_t> streamOffsets;        // Arena offset of each stream
+  std::vector<uint32_t> streamStrides;
+  uint32_t vertexCount = 0;
+};
+
+struct PrimitiveDraw
+{
+  uint32_t layout;
+  uint32_t mode;        // GL_TRIANGLES...
+  uint32_t indexType;   // GL_UNSIGNED_SHORT or INT, 0 if not indexed
+  uint32_t count;       // Number of indices, or of vertices if not indexed
+  uint32_t vertexCount;
+  uint64_t indexOffset; // Arena offset of the first index
+  int32_t baseVertex;   // First vertex in the pool of the layout
+  int32_t material;     // -1 for the default material
+  kln::Aabb bounds;     // Local space
+};
+
+struct MaterialData
+{
+  int32_t baseColorTexture; // Index in SceneData::textures, -1 if none
+  glm::vec4 baseColorFactor;
+  int32_t normalTexture; // Same, read with TEXCOORD_0
+  float normalScale;
+};
+
+// glTF texture with its sampler resolved, glTF filters and wraps are the GL
+// enums
+struct TextureData
+{
+  int32_t image; // -1 if the texture has no source
+  int32_t minFilter, magFilter;
+  int32_t wrapS, wrapT;
+};
+
+// Primitives of a mesh are contiguous in SceneData::primitives
+struct MeshRange
+{
+  uint32_t firstPrimitive;
+  uint32_t primitiveCount;
+};
+
+struct SceneNode
+{
+  glm::mat4 localMatrix;
+  int32_t mesh;        // -1 if the node has no mesh
+  uint32_t firstChild; // In SceneData::children
+  uint32_t childCount;
+};
+
+// Bytes of a glTF buffer: model.buffers[i].data, or the BIN chunk of a
+// mapped GLB file (see loadMappedGlb)
+struct BufferData
+{
+  const unsigned char *data;
+  size_t size;
+};
+
+// Data computed by cookSceneData instead of read from the glTF buffers
+struct GeneratedData
+{
+  // For the normal-mapped primitives without them, per vertex of the
+  // accessors
+  std::vector<glm::vec4> tangents;
+  // Reordered indices of the optimized primitives (see optimizeMeshes), of
+  // their compacted vertices
+  std::vector<uint32_t> indices;
+  // Accessor element of each compacted vertex of the optimized primitives
+  std::vector<uint32_t> remaps;
+};
+
+// Copy of an accessor, or of generated data, to the arena, see
+// writeSceneArena
+struct ArenaCopy
+{
+  static constexpr int32_t generatedTangents = -1;
+  static constexpr int32_t generatedIndices = -2;
+  static constexpr uint32_t noRemap = UINT32_MAX;
+
+  int32_t accessor;     // Or generatedTangents / generatedIndices
+  uint64_t offset;      // Arena offset of the first element
+  uint32_t stride;      // Between two elements in the arena
+  uint32_t elementSize; // In the arena, may differ for indices
+  uint32_t count;
+  uint32_t firstGenerated; // In GeneratedData, if accessor is negative
+  // Element i is the source element remaps[firstRemap + i], unless noRemap
+  uint32_t firstRemap;
+};
+
+// GPU-ready description of a glTF scene. Everything the scene draws lives in
+// one arena of arenaSize bytes: the vertex streams of every layout, then the
+// indices. Nodes, meshes, textures and images keep the indices of the glTF
+// model, so that the model is no longer needed once the scene is cooked.
+struct SceneData
+{
+  std::vector<VertexLayout> layouts;
+  std::vector<PrimitiveDraw> primitives;
+  std::vector<MeshRange> meshes;
+  std::vector<MaterialData> materials;
+  std::vector<TextureData> textures;
+  uint32_t imageCount = 0;
+  std::vector<SceneNode> nodes;
+  std::vector<uint32_t> children;
+  std::vector<uint32_t> roots; // Nodes of the displayed scene
+  std::vector<glm::mat4> worldMatrices; // Per node, identity if not displayed
+  std::vector<uint32_t> meshNodes; // Displayed nodes with a mesh, depth first
+  std::vector<ArenaCopy> copies; // Sorted by offset
+  // Shared by the copies of the scene until the arena is written
+  std::shared_ptr<const GeneratedData> generated;
+  uint64_t arenaSize = 0;
+};
+
+inline bool isMipmapFilter(int32_t filter)
+{
+  return filter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST ||
+         filter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR ||
+         filter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST ||
+         filter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+}
+
+// Data of model.buffers
+std::vector<BufferData> getBufferData(const tinygltf::Model &model);
+
+// Local bounds of POSITION accessors: their min/max, or a SIMD scan of their
+// elements for files without them and for quantized positions
+// (KHR_mesh_quantization), spread over pool if given. Bounds of accessors
+// that can't be read are empty.
+std::vector<kln::Aabb> computePositionBounds(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers,
+    const std::vector<int32_t> &accessors, ThreadPool *pool = nullptr);
+
+// Lays out the arena and fills everything but its content. Vertex data is
+// only read for positions without min/max, and to generate the tangents of
+// normal-mapped primitives without TANGENT (see generateTangents), both
+// spread over pool if given. Primitives that can't be drawn (sparse
+// accessors, no positions) are skipped with a message.
+// With optimizeMeshes, the indexed triangle lists are reordered for the
+// vertex cache and overdraw, and their vertices compacted in fetch order
+// (see meshOptimizer.hpp), on pool too.
+void cookSceneData(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, SceneData &scene,
+    ThreadPool *pool = nullptr, bool optimizeMeshes = false);
+
+// Writes the bytes [offset, offset + size) of the arena to dst, straight from
+// the glTF buffers, so that the arena never needs to exist as a whole in
+// memory. Padding bytes are zeroed.
+void writeSceneArena(const tinygltf::Model &model,
+    const std::vector<BufferData> &buffers, const SceneData &scene,
+    uint64_t offset, uint64_t size, void *dst);
+
+// Writes [offset, offset + size) of an arena to dst, wherever the arena comes
+// from (glTF buffers, scene cache...)
+using ArenaReader =
+    std::function<void(uint64_t offset, uint64_t size, void *dst)>;
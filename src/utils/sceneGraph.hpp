@@ -0,0 +1,131 @@
+#pragma once
+
+#include "sceneData.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Displayed nodes of a SceneData flattened depth first: a parent always comes
+// before its children and the subtree of node i is the range
+// [i, getSubtreeEnd(i)), so that world matrices are contiguous and updated by
+// linear passes. Moving a node only marks it dirty, update() then recomputes
+// the dirty subtrees and nothing else.
+class SceneGraph
+{
+public:
+  static constexpr uint32_t noParent = UINT32_MAX;
+
+  SceneGraph() = default;
+
+  explicit SceneGraph(const SceneData &scene)
+  {
+    m_FlatIndices.assign(scene.nodes.size(), noParent);
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // Node, flat parent
+    for (auto it = scene.roots.rbegin(); it != scene.roots.rend(); ++it) {
+      stack.emplace_back(*it, noParent);
+    }
+    while (!stack.empty()) {
+      const auto nodeIdx = stack.back().first;
+      const auto parent = stack.back().second;
+      stack.pop_back();
+      if (m_FlatIndices[nodeIdx] != noParent) {
+        continue; // Invalid file, a node can only have one parent
+      }
+      const auto &node = scene.nodes[nodeIdx];
+      m_FlatIndices[nodeIdx] = size();
+      m_Nodes.push_back(nodeIdx);
+      m_Parents.push_back(parent);
+      m_Meshes.push_back(node.mesh);
+      m_LocalMatrices.push_back(node.localMatrix);
+      m_WorldMatrices.push_back(scene.worldMatrices[nodeIdx]);
+      for (uint32_t i = node.childCount; i-- > 0;) {
+        stack.emplace_back(
+            scene.children[node.firstChild + i], m_FlatIndices[nodeIdx]);
+      }
+    }
+    // Children are after their parent, so subtrees end in reverse order
+    m_SubtreeEnds.resize(size());
+    for (auto i = size(); i-- > 0;) {
+      m_SubtreeEnds[i] = std::max(m_SubtreeEnds[i], i + 1);
+      if (m_Parents[i] != noParent) {
+        auto &parentEnd = m_SubtreeEnds[m_Parents[i]];
+        parentEnd = std::max(parentEnd, m_SubtreeEnds[i]);
+      }
+    }
+    m_Dirty.assign(size(), 0);
+  }
+
+  uint32_t size() const { return uint32_t(m_Nodes.size()); }
+
+  // Flat index of a node of SceneData::nodes, noParent if it isn't displayed
+  uint32_t getFlatIndex(uint32_t node) const { return m_FlatIndices[node]; }
+
+  uint32_t getNode(uint32_t i) const { return m_Nodes[i]; }
+
+  uint32_t getParent(uint32_t i) const { return m_Parents[i]; }
+
+  uint32_t getSubtreeEnd(uint32_t i) const { return m_SubtreeEnds[i]; }
+
+  int32_t getMesh(uint32_t i) const { return m_Meshes[i]; }
+
+  const glm::mat4 &getLocalMatrix(uint32_t i) const
+  {
+    return m_LocalMatrices[i];
+  }
+
+  // Up to date once update() is called
+  const glm::mat4 &getWorldMatrix(uint32_t i) const
+  {
+    return m_WorldMatrices[i];
+  }
+
+  void setLocalMatrix(uint32_t i, const glm::mat4 &localMatrix)
+  {
+    m_LocalMatrices[i] = localMatrix;
+    if (!m_Dirty[i]) {
+      m_Dirty[i] = 1;
+      m_DirtyNodes.push_back(i);
+    }
+  }
+
+  // Recomputes the world matrices of the subtrees of the nodes moved since
+  // the last update, calling moved(i) for each recomputed node. Returns the
+  // number of recomputed nodes.
+  template <typename Moved> uint32_t update(Moved &&moved)
+  {
+    // Dirty nodes inside a subtree already recomputed are skipped
+    std::sort(begin(m_DirtyNodes), end(m_DirtyNodes));
+    uint32_t updated = 0;
+    uint32_t doneEnd = 0;
+    for (const auto dirty : m_DirtyNodes) {
+      m_Dirty[dirty] = 0;
+      if (dirty < doneEnd) {
+        continue;
+      }
+      doneEnd = m_SubtreeEnds[dirty];
+      for (auto i = dirty; i < doneEnd; ++i) {
+        const auto parent = m_Parents[i];
+        m_WorldMatrices[i] =
+            parent == noParent ? m_LocalMatrices[i]
+                               : m_WorldMatrices[parent] * m_LocalMatrices[i];
+        moved(i);
+      }
+      updated += doneEnd - dirty;
+    }
+    m_DirtyNodes.clear();
+    return updated;
+  }
+
+private:
+  std::vector<uint32_t> m_Nodes;   // Index in SceneData::nodes
+  std::vector<uint32_t> m_Parents; // Flat index, noParent for roots
+  std::vector<uint32_t> m_SubtreeEnds;
+  std::vector<int32_t> m_Meshes;
+  std::vector<glm::mat4> m_LocalMatrices;
+  std::vector<glm::mat4> m_WorldMatrices;
+  std::vector<unsigned char> m_Dirty;
+  std::vector<uint32_t> m_DirtyNodes;
+  std::vector<uint32_t> m_FlatIndices; // Per node of SceneData::nodes
+};
@@ -0,0 +1,386 @@
+#include "sceneLoader.hpp"
+#include "glb.hpp"
+#include "hash.hpp"
+#include "images.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+// Image loader given to tinygltf: the encoded file is kept as is, it is
+// decoded later on the thread pool. Images in a buffer view are read from
+// their buffer instead.
+bool keepEncodedImage(tinygltf::Image *image, const int, std::string *,
+    std::string *, int, int, const unsigned char *bytes, int size, void *)
+{
+  if (image->bufferView < 0 && !isGlbChunkUri(image->uri)) {
+    image->image.assign(bytes, bytes + size);
+  }
+  image->as_is = true;
+  return true;
+}
+
+// What the arena of a scene parsed from its glTF file is read from, until it
+// is uploaded and cached
+struct GltfSource
+{
+  std::shared_ptr<const MappedFile> file; // Holds the buffers of GLB files
+  tinygltf::Model model;                  // Without its encoded images
+  std::vector<BufferData> buffers;
+  SceneData scene;
+};
+} // namespace
+
+AsyncSceneLoader::~AsyncSceneLoader()
+{
+  if (m_Cancel) {
+    *m_Cancel = true;
+  }
+  for (auto &job : m_Jobs) {
+    job.wait();
+  }
+  m_Staging.release();
+}
+
+void AsyncSceneLoader::load(
+    const fs::path &path, const SceneLoadOptions &options)
+{
+  if (m_Cancel) {
+    *m_Cancel = true;
+  }
+  m_Cancel = std::make_shared<std::atomic<bool>>(false);
+  const auto loadId = ++m_LoadId;
+  m_Loading = true;
+  m_Uploading = false;
+  m_PendingImages.clear();
+  m_Jobs.erase(std::remove_if(begin(m_Jobs), end(m_Jobs),
+                   [](const std::future<void> &job) {
+                     return job.wait_for(std::chrono::seconds(0)) ==
+                            std::future_status::ready;
+                   }),
+      end(m_Jobs));
+  m_Jobs.push_back(m_Pool.submit(
+      [this, path, options, loadId, cancel = m_Cancel]() {
+        loadOnWorker(path, options, loadId, *cancel);
+      }));
+}
+
+void AsyncSceneLoader::loadOnWorker(const fs::path &path,
+    const SceneLoadOptions &options, uint32_t loadId,
+    const std::atomic<bool> &cancel)
+{
+  // Mapped once, for the hash then for the parser
+  auto source = std::make_shared<MappedFile>();
+  if (!source->open(path)) {
+    std::cerr << "Unable to open glTF file " << path << std::endl;
+    push({loadId, true, nullptr, nullptr}, cancel);
+    return;
+  }
+  // Optimized scenes have another arena, and compressed textures other
+  // images, so they have another cache file
+  auto cacheKey = hashBytes(source->data(), source->size());
+  if (options.optimizeMeshes) {
+    cacheKey = hashString("optimizeMeshes", cacheKey);
+  }
+  const auto &formats = options.textureFormats;
+  if (formats.opaque != PixelFormat::Rgba8 ||
+      formats.transparent != PixelFormat::Rgba8) {
+    cacheKey = hashBytes(&formats, sizeof(formats), cacheKey);
+  }
+  if (m_CacheDirectory.empty() ||
+      !loadFromCache(path, cacheKey, loadId, cancel)) {
+    loadFromSource(
+        path, std::move(source), options, cacheKey, loadId, cancel);
+  }
+}
+
+bool AsyncSceneLoader::loadFromCache(const fs::path &path, uint64_t cacheKey,
+    uint32_t loadId, const std::atomic<bool> &cancel)
+{
+  const auto cachePath = getSceneCachePath(m_CacheDirectory, cacheKey);
+  const auto file = std::make_shared<MappedFile>();
+  if (!file->open(cachePath)) {
+    return false;
+  }
+  auto loaded = std::make_unique<LoadedScene>();
+  loaded->path = path;
+  const unsigned char *arena = nullptr;
+  std::vector<SceneCacheImage> images;
+  // Textures are mapped before the scene is given, a missing one makes the
+  // scene cache stale
+  const auto textureCacheDirectory = getTextureCacheDirectory(m_CacheDirectory);
+  std::vector<std::shared_ptr<const DecodedImage>> decodedImages;
+  bool valid = readSceneCache(
+      *file, cacheKey, path.parent_path(), loaded->scene, arena, images);
+  for (size_t i = 0; valid && i < images.size(); ++i) {
+    std::shared_ptr<const void> owner;
+    ImageMips mips;
+    if (images[i].decoded) {
+      mips = mapTexture(textureCacheDirectory, images[i].textureKey, owner);
+      valid = mips.pixels != nullptr;
+    }
+    decodedImages.push_back(std::make_shared<DecodedImage>(
+        DecodedImage{int32_t(i), mips, std::move(owner)}));
+  }
+  if (!valid) {
+    std::cerr << "Ignoring stale scene cache " << cachePath << std::endl;
+    return false;
+  }
+  loaded->readArena = [file, arena](uint64_t offset, uint64_t size,
+                          void *dst) {
+    std::memcpy(dst, arena + offset, size);
+  };
+  push({loadId, false, std::move(loaded), nullptr}, cancel);
+  for (auto &image : decodedImages) {
+    push({loadId, false, nullptr, std::move(image)}, cancel);
+  }
+  return true;
+}
+
+void AsyncSceneLoader::loadFromSource(const fs::path &path,
+    std::shared_ptr<const MappedFile> file, const SceneLoadOptions &options,
+    uint64_t cacheKey, uint32_t loadId, const std::atomic<bool> &cancel)
+{
+  const auto source = std::make_shared<GltfSource>();
+  auto &model = source->model;
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(keepEncodedImage, nullptr);
+  std::string err;
+  std::string warn;
+  const auto baseDirectory = path.parent_path().string();
+  bool ret;
+  if (path.extension() == ".glb") {
+    // The BIN chunk is used in place, see loadMappedGlb
+    ret = loadMappedGlb(
+        loader, *file, baseDirectory, model, source->buffers, &err, &warn);
+    source->file = std::move(file);
+  } else {
+    ret = loader.LoadASCIIFromString(&model, &err, &warn,
+        reinterpret_cast<const char *>(file->data()),
+        static_cast<unsigned int>(file->size()), baseDirectory);
+    source->buffers = getBufferData(model);
+    file.reset();
+  }
+  if (!warn.empty()) {
+    std::cerr << "Warning: " << warn << std::endl;
+  }
+  if (!err.empty()) {
+    std::cerr << "Error: " << err << std::endl;
+  }
+  if (!ret) {
+    std::cerr << "Failed to parse glTF file " << path << std::endl;
+    push({loadId, true, nullptr, nullptr}, cancel);
+    return;
+  }
+  if (cancel) {
+    return;
+  }
+
+  auto loaded = std::make_unique<LoadedScene>();
+  loaded->path = path;
+  cookSceneData(
+      model, source->buffers, source->scene, &m_Pool, options.optimizeMeshes);
+  loaded->scene = source->scene;
+
+  // Images are found in their buffer view, or taken out of the model before
+  // it is shared with the GL thread
+  const auto dependencies = getSceneDependencies(model, path.parent_path());
+  std::vector<std::vector<unsigned char>> encodedFiles(model.images.size());
+  std::vector<BufferData> encodedImages(model.images.size(), {nullptr, 0});
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    auto &image = model.images[i];
+    if (image.bufferView < 0) {
+      encodedFiles[i] = std::move(image.image);
+      encodedImages[i] = {encodedFiles[i].data(), encodedFiles[i].size()};
+    } else if (size_t(image.bufferView) < model.bufferViews.size()) {
+      const auto &view = model.bufferViews[image.bufferView];
+      const auto &buffer = source->buffers[view.buffer];
+      if (view.byteOffset <= buffer.size &&
+          view.byteLength <= buffer.size - view.byteOffset) {
+        encodedImages[i] = {buffer.data + view.byteOffset, view.byteLength};
+      }
+    }
+  }
+
+  // The arena is gathered from the buffers by the GL thread, straight into
+  // its staging buffer
+  loaded->readArena = [source](uint64_t offset, uint64_t size, void *dst) {
+    writeSceneArena(
+        source->model, source->buffers, source->scene, offset, size, dst);
+  };
+  push({loadId, false, std::move(loaded), nullptr}, cancel);
+
+  // The scene cache only records where the texture cache put the images
+  const auto textureCacheDirectory = getTextureCacheDirectory(m_CacheDirectory);
+  std::vector<SceneCacheImage> images(encodedImages.size());
+  m_Pool.parallelFor(encodedImages.size(), [&](size_t i) {
+    if (cancel) {
+      return;
+    }
+    const auto &encoded = encodedImages[i];
+    const auto key = getTextureCacheKey(
+        encoded.data, encoded.size, options.textureFormats);
+    std::shared_ptr<const void> owner;
+    const auto mips = decodeTexture(encoded.data, encoded.size,
+        options.textureFormats, key, textureCacheDirectory, owner);
+    if (!mips.pixels) {
+      std::cerr << "Failed to decode image " << i << " of " << path
+                << std::endl;
+    }
+    images[i] = {key, mips.pixels != nullptr, 0};
+    push({loadId, false, nullptr,
+             std::make_shared<DecodedImage>(
+                 DecodedImage{int32_t(i), mips, std::move(owner)})},
+        cancel);
+  });
+
+  if (!m_CacheDirectory.empty() && !cancel) {
+    const auto cachePath = getSceneCachePath(m_CacheDirectory, cacheKey);
+    writeSceneCache(cachePath, cacheKey, source->scene,
+        [&](uint64_t offset, uint64_t size, void *dst) {
+          writeSceneArena(
+              model, source->buffers, source->scene, offset, size, dst);
+        },
+        images, dependencies);
+  }
+}
+
+void AsyncSceneLoader::push(Message &&message, const std::atomic<bool> &cancel)
+{
+  // The queue is only full if the GL thread is far behind, wait for it
+  while (!m_Queue.tryPush(std::move(message))) {
+    if (cancel) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool AsyncSceneLoader::pollScene()
+{
+  bool newScene = false;
+  Message message;
+  while (m_Queue.tryPop(message)) {
+    if (message.loadId != m_LoadId) {
+      continue; // Abandoned load
+    }
+    if (message.failed) {
+      m_Loading = false;
+    }
+    if (message.scene) {
+      m_Scene = std::move(message.scene);
+      m_Uploading = false;
+      newScene = true;
+    }
+    if (message.image) {
+      m_PendingImages.push_back(std::move(message.image));
+    }
+  }
+  return newScene;
+}
+
+void AsyncSceneLoader::beginUpload(
+    GLuint arenaBuffer, const std::vector<GLuint> &textures)
+{
+  const auto &scene = m_Scene->scene;
+  m_ArenaBuffer = arenaBuffer;
+
+  // Ranges are ordered by primitive so that each one is drawn as soon as
+  // possible, instead of once every vertex stream is in
+  m_Ranges.clear();
+  for (size_t i = 0; i < scene.primitives.size(); ++i) {
+    const auto &primitive = scene.primitives[i];
+    const auto &layout = scene.layouts[primitive.layout];
+    for (size_t j = 0; j < layout.attributes.size(); ++j) {
+      const uint64_t stride = layout.streamStrides[j];
+      m_Ranges.push_back(
+          {layout.streamOffsets[j] + stride * primitive.baseVertex,
+              stride * primitive.vertexCount, -1});
+    }
+    if (primitive.indexType) {
+      const uint64_t indexSize =
+          primitive.indexType == GL_UNSIGNED_INT ? 4 : 2;
+      m_Ranges.push_back(
+          {primitive.indexOffset, indexSize * primitive.count, -1});
+    }
+    m_Ranges.back().primitive = int32_t(i);
+  }
+  m_NextRange = 0;
+  m_RangeDone = 0;
+  m_ArenaUploaded = 0;
+  m_PrimitiveReady.assign(scene.primitives.size(), 0);
+
+  m_Textures.reset(scene, textures);
+  m_ImagesLeft = scene.imageCount;
+  m_Uploading = true;
+}
+
+void AsyncSceneLoader::upload(size_t budget)
+{
+  if (!m_Uploading) {
+    return;
+  }
+  // Geometry first, the shape of the scene matters more than its textures
+  const auto spent = uploadArena(budget);
+  for (; !m_PendingImages.empty(); m_PendingImages.pop_front()) {
+    m_Textures.addImage(std::move(m_PendingImages.front()));
+    --m_ImagesLeft;
+  }
+  if (m_NextRange == m_Ranges.size() && !m_ImagesLeft) {
+    m_Loading = false;
+  }
+  m_Textures.update(budget - std::min(spent, budget), m_Staging);
+}
+
+size_t AsyncSceneLoader::uploadArena(size_t budget)
+{
+  size_t spent = 0;
+  const auto maxChunk = size_t(m_Staging.getSegmentSize());
+  while (m_NextRange < m_Ranges.size() && spent < budget) {
+    const auto &range = m_Ranges[m_NextRange];
+    const auto chunk = std::min<uint64_t>(
+        {range.size - m_RangeDone, maxChunk, budget - spent});
+    if (chunk) {
+      GLintptr stagingOffset;
+      const auto staging = m_Staging.map(chunk, 4, stagingOffset);
+      m_Scene->readArena(range.offset + m_RangeDone, chunk, staging);
+      glBindBuffer(GL_COPY_READ_BUFFER, m_Staging.getBuffer());
+      glBindBuffer(GL_COPY_WRITE_BUFFER, m_ArenaBuffer);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+          stagingOffset, range.offset + m_RangeDone, chunk);
+      m_RangeDone += chunk;
+      m_ArenaUploaded += chunk;
+      spent += chunk;
+    }
+    if (m_RangeDone == range.size) {
+      if (range.primitive >= 0) {
+        m_PrimitiveReady[range.primitive] = 1;
+      }
+      ++m_NextRange;
+      m_RangeDone = 0;
+    }
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  if (m_NextRange == m_Ranges.size()) {
+    m_Scene->readArena = nullptr; // Releases the buffers or the mapping
+  }
+  return spent;
+}
+
+float AsyncSceneLoader::getProgress() const
+{
+  if (!m_Scene) {
+    return 0.f;
+  }
+  const auto imageCount = m_Scene->scene.imageCount;
+  const auto arenaSize = m_Scene->scene.arenaSize;
+  const auto arena = arenaSize ? float(m_ArenaUploaded) / arenaSize : 1.f;
+  const auto images =
+      imageCount ? float(imageCount - m_ImagesLeft) / imageCount : 1.f;
+  return 0.5f * (arena + images);
+}
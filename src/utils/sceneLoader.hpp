@@ -0,0 +1,140 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "glad/glad.h"
+#include "mpmcQueue.hpp"
+#include "sceneCache.hpp"
+#include "sceneData.hpp"
+#include "streamBuffer.hpp"
+#include "textureCache.hpp"
+#include "textureResidency.hpp"
+#include "threadPool.hpp"
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+// glTF file cooked by the workers, or read from the scene cache. Images come
+// separately.
+struct LoadedScene
+{
+  fs::path path;
+  SceneData scene;
+  ArenaReader readArena; // From the source or cache file, empty once uploaded
+};
+
+// How a scene is cooked, each combination has its own cache file
+struct SceneLoadOptions
+{
+  bool optimizeMeshes = false; // See cookSceneData
+  TextureFormats textureFormats;
+};
+
+// Loads glTF files on a thread pool while the GL thread keeps rendering.
+// Workers parse the file, cook the scene and decode its images in parallel,
+// then hand their results to the GL thread through a lock-free queue. They
+// also write the result to the scene cache, so that the next load of the
+// same file with the same options only maps the cache file, and the decoded
+// images to the texture cache (see decodeTexture), which the scene cache
+// refers to instead of holding the images again. The GL thread uploads them
+// a few megabytes per frame through a persistently mapped staging ring (see
+// StreamBuffer), so that the scene appears primitive by primitive. Textures
+// get the levels the view needs, see TextureResidency.
+class AsyncSceneLoader
+{
+public:
+  // An empty cacheDirectory disables the scene cache
+  AsyncSceneLoader(ThreadPool &pool, const fs::path &cacheDirectory) :
+      m_Pool{pool}, m_CacheDirectory{cacheDirectory}
+  {
+  }
+  ~AsyncSceneLoader();
+
+  // Starts loading path, the load in progress (if any) is abandoned
+  void load(const fs::path &path, const SceneLoadOptions &options = {});
+
+  // Takes the results of the workers, returns true once per load, when the
+  // scene is cooked and its GL objects must be created (see beginUpload)
+  bool pollScene();
+
+  const LoadedScene *getScene() const { return m_Scene.get(); }
+
+  // Streams getScene() into arenaBuffer (see createBufferObjects) and
+  // textures, one per SceneData::textures, as the data comes. Textures are
+  // mutable and empty, their levels are managed by getTextures().
+  void beginUpload(GLuint arenaBuffer, const std::vector<GLuint> &textures);
+
+  // Uploads at most budget bytes, call once per frame before the draws: the
+  // copies bind buffers and textures directly (see GLStateCache)
+  void upload(size_t budget);
+
+  TextureResidency &getTextures() { return m_Textures; }
+  const TextureResidency &getTextures() const { return m_Textures; }
+
+  bool isPrimitiveReady(uint32_t primitive) const
+  {
+    return m_PrimitiveReady[primitive];
+  }
+
+  bool isTextureReady(int32_t texture) const
+  {
+    return m_Textures.isReady(texture);
+  }
+
+  bool isLoading() const { return m_Loading; }
+
+  // Fraction of the arena that has been uploaded and of the images that
+  // have been decoded
+  float getProgress() const;
+
+private:
+  struct Message
+  {
+    uint32_t loadId = 0;
+    bool failed = false;
+    std::unique_ptr<LoadedScene> scene;
+    std::shared_ptr<const DecodedImage> image; // Shared with the cache
+  };
+
+  // Part of the arena, primitives are drawable once their last range is in
+  struct UploadRange
+  {
+    uint64_t offset, size;
+    int32_t primitive; // Made ready by this range, -1 if none
+  };
+
+  void loadOnWorker(const fs::path &path, const SceneLoadOptions &options,
+      uint32_t loadId, const std::atomic<bool> &cancel);
+  bool loadFromCache(const fs::path &path, uint64_t cacheKey, uint32_t loadId,
+      const std::atomic<bool> &cancel);
+  void loadFromSource(const fs::path &path,
+      std::shared_ptr<const MappedFile> file, const SceneLoadOptions &options,
+      uint64_t cacheKey, uint32_t loadId, const std::atomic<bool> &cancel);
+  void push(Message &&message, const std::atomic<bool> &cancel);
+  size_t uploadArena(size_t budget);
+
+  ThreadPool &m_Pool;
+  const fs::path m_CacheDirectory;
+  MpmcQueue<Message> m_Queue{256};
+  std::vector<std::future<void>> m_Jobs;
+  std::shared_ptr<std::atomic<bool>> m_Cancel;
+  uint32_t m_LoadId = 0;
+  bool m_Loading = false;
+
+  // GL thread side
+  std::unique_ptr<LoadedScene> m_Scene;
+  StreamBuffer m_Staging{8 * 1024 * 1024};
+  GLuint m_ArenaBuffer = 0;
+  std::vector<UploadRange> m_Ranges;
+  size_t m_NextRange = 0;
+  uint64_t m_RangeDone = 0;     // Bytes of m_Ranges[m_NextRange] uploaded
+  uint64_t m_ArenaUploaded = 0; // Bytes of the arena uploaded
+  std::vector<unsigned char> m_PrimitiveReady;
+  TextureResidency m_Textures;
+  // Decoded before beginUpload, or not given to m_Textures yet
+  std::deque<std::shared_ptr<const DecodedImage>> m_PendingImages;
+  size_t m_ImagesLeft = 0;
+  bool m_Uploading = false;
+};
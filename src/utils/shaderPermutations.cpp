@@ -0,0 +1,130 @@
+#include "shaderPermutations.hpp"
+#include "glExtensions.hpp"
+#include "uniformHandler.hpp"
+
+// From KHR_parallel_shader_compile, which glad wasn't generated with
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace
+{
+bool hasParallelCompile()
+{
+  return isExtensionSupported("GL_KHR_parallel_shader_compile") ||
+         isExtensionSupported("GL_ARB_parallel_shader_compile");
+}
+} // namespace
+
+ShaderPermutations::ShaderPermutations(ProgramCache &cache,
+    std::vector<fs::path> shaderPaths, std::vector<std::string> defineNames) :
+    m_Cache{cache},
+    m_ShaderPaths{std::move(shaderPaths)},
+    m_DefineNames{std::move(defineNames)},
+    m_ParallelCompile{hasParallelCompile()},
+    m_Fallback{cache.load(m_ShaderPaths)}
+{
+  UniformHandler{m_Fallback}; // Binds its uniform blocks
+}
+
+const GLProgram &ShaderPermutations::get(uint32_t mask)
+{
+  if (!mask) {
+    return m_Fallback;
+  }
+  auto &variant = m_Variants[mask];
+  if (!variant) {
+    variant = std::make_unique<Variant>();
+    compile(mask, *variant);
+  }
+  return variant->ready ? variant->program : m_Fallback;
+}
+
+void ShaderPermutations::poll()
+{
+  // Without the extension any query waits, so only one variant is finished
+  // per frame
+  auto done = begin(m_Pending);
+  for (auto it = begin(m_Pending); it != end(m_Pending); ++it) {
+    auto &variant = *m_Variants[*it];
+    GLint status = GL_TRUE;
+    if (m_ParallelCompile) {
+      glGetProgramiv(variant.program.glId(), GL_COMPLETION_STATUS_KHR, &status);
+    } else if (it != begin(m_Pending)) {
+      status = GL_FALSE;
+    }
+    if (status == GL_TRUE) {
+      finish(*it, variant);
+    } else {
+      *done++ = *it;
+    }
+  }
+  m_Pending.erase(done, end(m_Pending));
+}
+
+std::vector<std::string> ShaderPermutations::getDefines(uint32_t mask) const
+{
+  std::vector<std::string> defines;
+  for (size_t i = 0; i < m_DefineNames.size(); ++i) {
+    if (mask & (1u << i)) {
+      defines.push_back(m_DefineNames[i]);
+    }
+  }
+  return defines;
+}
+
+void ShaderPermutations::compile(uint32_t mask, Variant &variant)
+{
+  const auto defines = getDefines(mask);
+  if (m_Cache.isEnabled()) {
+    variant.key = m_Cache.getKey(m_ShaderPaths, defines);
+    if (m_Cache.loadBinary(variant.key, variant.program)) {
+      UniformHandler{variant.program};
+      variant.ready = true;
+      ++m_ReadyCount;
+      return;
+    }
+    variant.program = GLProgram{}; // The rejected binary may stay attached
+  }
+
+  // No status query until poll, so the driver doesn't have to wait
+  std::clog << "Compiling variant " << mask << " of " << m_ShaderPaths.front()
+            << "\n";
+  for (const auto &path : m_ShaderPaths) {
+    variant.shaders.emplace_back(getShaderType(path));
+    auto &shader = variant.shaders.back();
+    shader.setSource(loadShaderSource(path, defines));
+    glCompileShader(shader.glId());
+    variant.program.attachShader(shader);
+  }
+  if (m_Cache.isEnabled()) {
+    glProgramParameteri(
+        variant.program.glId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glLinkProgram(variant.program.glId());
+  m_Pending.push_back(mask);
+}
+
+void ShaderPermutations::finish(uint32_t mask, Variant &variant)
+{
+  if (!variant.program.getLinkStatus()) {
+    // The fallback keeps drawing it
+    for (const auto &shader : variant.shaders) {
+      if (!shader.getCompileStatus()) {
+        std::cerr << "Shader compilation error:" << shader.getInfoLog()
+                  << std::endl;
+      }
+    }
+    std::cerr << "Variant " << mask << " link error:"
+              << variant.program.getInfoLog() << std::endl;
+    variant.shaders.clear();
+    return;
+  }
+  variant.shaders.clear(); // Deleted with the program
+  UniformHandler{variant.program};
+  if (m_Cache.isEnabled()) {
+    m_Cache.storeBinary(variant.key, variant.program);
+  }
+  variant.ready = true;
+  ++m_ReadyCount;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "programCache.hpp"
+#include "shaders.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Variants of a program specialized by #define sets, so that features are
+// selected by the preprocessor instead of branching at runtime. A variant is
+// named by a mask, bit i defining defineNames[i], and is compiled the first
+// time it is asked for. With KHR_parallel_shader_compile the driver compiles
+// the variants on its own threads and poll only checks whether they are done,
+// otherwise poll finishes one of them per call. Until then, get returns the
+// fallback program, compiled without defines, which must handle every case.
+class ShaderPermutations
+{
+public:
+  // Compiles the fallback, through the cache like the variants
+  ShaderPermutations(ProgramCache &cache, std::vector<fs::path> shaderPaths,
+      std::vector<std::string> defineNames);
+
+  ShaderPermutations(const ShaderPermutations &) = delete;
+  ShaderPermutations &operator=(const ShaderPermutations &) = delete;
+
+  // The variant of mask if it is linked, the fallback otherwise. Starts its
+  // compilation on the first call.
+  const GLProgram &get(uint32_t mask);
+
+  // Finishes the variants whose compilation is done, once per frame
+  void poll();
+
+  const GLProgram &getFallback() const { return m_Fallback; }
+  size_t getReadyCount() const { return m_ReadyCount; }
+  size_t getPendingCount() const { return m_Pending.size(); }
+
+private:
+  struct Variant
+  {
+    GLProgram program;
+    std::vector<GLShader> shaders; // Until linked, for their logs
+    uint64_t key = 0; // In the program cache
+    bool ready = false;
+  };
+
+  std::vector<std::string> getDefines(uint32_t mask) const;
+  void compile(uint32_t mask, Variant &variant);
+  // Checks the link status, which waits for the driver if it isn't done
+  void finish(uint32_t mask, Variant &variant);
+
+  ProgramCache &m_Cache;
+  const std::vector<fs::path> m_ShaderPaths;
+  const std::vector<std::string> m_DefineNames;
+  const bool m_ParallelCompile;
+  GLProgram m_Fallback;
+  std::unordered_map<uint32_t, std::unique_ptr<Variant>> m_Variants;
+  std::vector<uint32_t> m_Pending; // Masks of the variants being compiled
+  size_t m_ReadyCount = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "filesystem.hpp"
+#include <algorithm>
 #include <fstream>
 #include <glad/glad.h>
 #include <iostream>
@@ -81,6 +82,36 @@ inline std::string loadShaderSource(const fs::path &filepath)
   return buffer.str();
 }
 
+// Source of filepath with a #define line per name in defines, inserted after
+// the #version line which must stay first. The #line directive that follows
+// keeps the line numbers of the compile errors.
+inline std::string loadShaderSource(
+    const fs::path &filepath, const std::vector<std::string> &defines)
+{
+  auto source = loadShaderSource(filepath);
+  if (defines.empty()) {
+    return source;
+  }
+  size_t position = 0;
+  const auto version = source.find("#version");
+  if (version != std::string::npos) {
+    position = source.find('\n', version);
+    if (position == std::string::npos) {
+      source += '\n';
+      position = source.size() - 1;
+    }
+    ++position;
+  }
+  const auto line = std::count(begin(source), begin(source) + position, '\n');
+  std::string block;
+  for (const auto &define : defines) {
+    block += "#define " + define + "\n";
+  }
+  block += "#line " + std::to_string(line + 1) + "\n";
+  source.insert(position, block);
+  return source;
+}
+
 template <typename StringType>
 GLShader compileShader(GLenum type, StringType &&src)
 {
@@ -93,19 +124,16 @@ GLShader compileShader(GLenum type, StringType &&src)
   return shader;
 }
 
-// Load and compile a shader according to the following naming convention:
+// Shader type of a file, according to the following naming convention:
 // *.vs.glsl -> vertex shader
 // *.fs.glsl -> fragment shader
 // *.gs.glsl -> geometry shader
 // *.cs.glsl -> compute shader
-inline GLShader loadShader(const fs::path &shaderPath)
+inline GLenum getShaderType(const fs::path &shaderPath)
 {
-  static auto extToShaderType =
-      std::unordered_map<std::string, std::pair<GLenum, std::string>>(
-          {{".vs", {GL_VERTEX_SHADER, "vertex"}},
-              {".fs", {GL_FRAGMENT_SHADER, "fragment"}},
-              {".gs", {GL_GEOMETRY_SHADER, "geometry"}},
-              {".cs", {GL_COMPUTE_SHADER, "compute"}}});
+  static auto extToShaderType = std::unordered_map<std::string, GLenum>(
+      {{".vs", GL_VERTEX_SHADER}, {".fs", GL_FRAGMENT_SHADER},
+          {".gs", GL_GEOMETRY_SHADER}, {".cs", GL_COMPUTE_SHADER}});
 
   const auto ext = shaderPath.stem().extension();
   const auto it = extToShaderType.find(ext.string());
@@ -113,12 +141,24 @@ inline GLShader loadShader(const fs::path &shaderPath)
     std::cerr << "Unrecognized shader extension " << ext << std::endl;
     throw std::runtime_error("Unrecognized shader extension " + ext.string());
   }
+  return (*it).second;
+}
 
-  std::clog << "Compiling " << (*it).second.second << " shader " << shaderPath
+// Load and compile a shader, its type given by getShaderType, with the
+// defines of loadShaderSource
+inline GLShader loadShader(
+    const fs::path &shaderPath, const std::vector<std::string> &defines = {})
+{
+  static auto typeNames = std::unordered_map<GLenum, std::string>(
+      {{GL_VERTEX_SHADER, "vertex"}, {GL_FRAGMENT_SHADER, "fragment"},
+          {GL_GEOMETRY_SHADER, "geometry"}, {GL_COMPUTE_SHADER, "compute"}});
+
+  const auto type = getShaderType(shaderPath);
+  std::clog << "Compiling " << typeNames[type] << " shader " << shaderPath
             << "\n";
 
-  GLShader shader{(*it).second.first};
-  shader.setSource(loadShaderSource(shaderPath));
+  GLShader shader{type};
+  shader.setSource(loadShaderSource(shaderPath, defines));
   shader.compile();
   if (!shader.getCompileStatus()) {
     std::cerr << "Shader compilation error:" << shader.getInfoLog()
@@ -244,13 +284,21 @@ template <typename CSrc> GLProgram buildComputeProgram(CSrc &&src)
   ;
 }
 
-inline GLProgram compileProgram(std::vector<fs::path> shaderPaths)
+// binaryRetrievable asks the driver to keep the binary of the program for
+// glGetProgramBinary, see ProgramCache. defines go to every shader.
+inline GLProgram compileProgram(std::vector<fs::path> shaderPaths,
+    bool binaryRetrievable = false,
+    const std::vector<std::string> &defines = {})
 {
   GLProgram program;
   for (const auto &path : shaderPaths) {
-    auto shader = loadShader(path);
+    auto shader = loadShader(path, defines);
     program.attachShader(shader);
   }
+  if (binaryRetrievable) {
+    glProgramParameteri(
+        program.glId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
   program.link();
   if (!program.getLinkStatus()) {
     std::cerr << "Program link error:" << program.getInfoLog() << std::endl;
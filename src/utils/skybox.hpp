@@ -1,39 +1,69 @@
 #pragma once
 
 #include "cube.hpp"
+#include "mappedFile.hpp"
+#include "programCache.hpp"
 #include "shaders.hpp"
+#include "textureCache.hpp"
+#include "threadPool.hpp"
 #include "uniformHandler.hpp"
 
-#include <stb_image.h>
+#include <memory>
 
 class Skybox
 {
 public:
-  Skybox(const std::vector<std::string> &faces,
-      const fs::path &m_ShadersRootPath) :
-      cube{200, 200, 200},
-      program{compileProgram({m_ShadersRootPath / "skybox.vs.glsl",
+  // The cube is the 2x2x2 one of the scene, the vertex shader scales it. The
+  // faces are decoded on pool, through the texture cache (see decodeTexture).
+  Skybox(GeometryRegistry &geometry, const std::vector<std::string> &faces,
+      const fs::path &m_ShadersRootPath, ProgramCache &programs,
+      ThreadPool &pool, const TextureFormats &formats,
+      const fs::path &textureCacheDirectory) :
+      m_Geometry{geometry},
+      m_Cube{CubeCustom::addGeometry(geometry, 2, 2, 2)},
+      program{programs.load({m_ShadersRootPath / "skybox.vs.glsl",
           m_ShadersRootPath / "skybox.fs.glsl"})},
       skyHandler(program)
   {
+    // Every face in the same format, the sky is opaque anyway
+    const TextureFormats faceFormats{formats.opaque, formats.opaque};
+    std::vector<ImageMips> mips(faces.size());
+    std::vector<std::shared_ptr<const void>> owners(faces.size());
+    pool.parallelFor(faces.size(), [&](size_t i) {
+      MappedFile file;
+      if (file.open(faces[i])) {
+        mips[i] = decodeTexture(file.data(), file.size(), faceFormats,
+            textureCacheDirectory, owners[i]);
+      }
+    });
+
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
+    const auto &first = mips.front();
     for (unsigned int i = 0; i < faces.size(); i++) {
-      unsigned char *data =
-          stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-      if (data) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width,
-            height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
-      } else {
+      if (!mips[i].pixels) {
         std::cout << "Cubemap tex failed to load at path: " << faces[i]
                   << std::endl;
-        stbi_image_free(data);
+      } else if (mips[i].width != first.width ||
+                 mips[i].height != first.height ||
+                 mips[i].format != first.format) {
+        std::cout << "Cubemap tex doesn't match the first face: " << faces[i]
+                  << std::endl;
+      } else {
+        if (i == 0) {
+          glTexStorage2D(GL_TEXTURE_CUBE_MAP, first.levelCount,
+              getInternalFormat(first.format), first.width, first.height);
+        }
+        for (uint32_t level = 0; level < first.levelCount; ++level) {
+          uploadMipLevelRows(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mips[i],
+              level, 0, getMipLevelRows(first.height, level, first.format),
+              mips[i].pixels + getMipLevelOffset(first.width, first.height,
+                                   level, first.format));
+        }
       }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(
+        GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -41,21 +71,21 @@ public:
   }
 
   // Function that draws a cube and apply the skybox on it
-  void draw(const glm::mat4 &modelMatrix, const glm::mat4 &viewMatrix,
-      const glm::mat4 &projMatrix)
+  // The matrix (without the camera translation) comes from the FrameUniforms
+  // block, see FrameUniformBuffer
+  void draw(GLStateCache &state)
   {
-    glDepthMask(GL_FALSE);
-    program.use();
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    const auto skyViewMatrix =
-        glm::mat4(glm::mat3(viewMatrix)); // skybox will not use translation
-    cube.draw(modelMatrix, skyViewMatrix, projMatrix,
-        skyHandler.uModelViewProjMatrix);
-    glDepthMask(GL_TRUE);
+    state.setDepthMask(false);
+    state.useProgram(program.glId());
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+    m_Geometry.bind(state);
+    m_Geometry.draw(m_Cube);
+    state.setDepthMask(true);
   }
 
 private:
-  CubeCustom cube;
+  GeometryRegistry &m_Geometry;
+  GeometryHandle m_Cube;
   GLuint textureID;
   GLProgram program;
   UniformHandler skyHandler;
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "glStateCache.hpp"
+#include "glad/glad.h"
+
+#include <array>
+#include <cstring>
+
+// Ring buffer for geometry rewritten every frame (the rope, the culled cube
+// instances...). The storage is allocated once and stays persistently mapped,
+// so streaming never creates nor reallocates a buffer. It is split in
+// segmentCount segments and a segment is only rewritten once the GPU is done
+// with the draws that read it, which is tracked with one fence per segment.
+// The buffer is created on the first upload, once there is a GL context.
+class StreamBuffer
+{
+public:
+  static constexpr int segmentCount = 3;
+
+  explicit StreamBuffer(GLsizeiptr segmentSize = 64 * 1024) :
+      m_SegmentSize{segmentSize}
+  {
+  }
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  // Copies size bytes into the ring and returns their offset in getBuffer(),
+  // rounded up to a multiple of alignment (e.g. the vertex stride). The data
+  // stays valid until segmentCount segments have been filled after it.
+  // Uploads made during the draws give their GLStateCache, which then makes
+  // the GL_ARRAY_BUFFER binds of a (re)allocation.
+  GLintptr upload(const void *data, GLsizeiptr size, GLsizeiptr alignment = 16,
+      GLStateCache *state = nullptr)
+  {
+    GLintptr offset;
+    std::memcpy(map(size, alignment, offset, state), data, size);
+    return offset;
+  }
+
+  // Like upload, but returns where to write the size bytes instead of copying
+  // them, for data that is gathered from several places
+  void *map(GLsizeiptr size, GLsizeiptr alignment, GLintptr &offset,
+      GLStateCache *state = nullptr)
+  {
+    if (!m_Buffer || size > m_SegmentSize) {
+      auto segmentSize = m_SegmentSize;
+      while (segmentSize < size) {
+        segmentSize *= 2;
+      }
+      allocate(segmentSize, state);
+    }
+    auto segmentOffset = (m_Cursor + alignment - 1) / alignment * alignment;
+    if (segmentOffset + size > m_SegmentSize) {
+      nextSegment();
+      segmentOffset = 0;
+    }
+    m_Cursor = segmentOffset + size;
+    offset = m_Segment * m_SegmentSize + segmentOffset;
+    return m_Mapped + offset;
+  }
+
+  GLuint getBuffer() const { return m_Buffer; }
+
+  // Largest upload that doesn't make the buffer grow
+  GLsizeiptr getSegmentSize() const { return m_SegmentSize; }
+
+  // Not done in a destructor: owners can be globals that outlive the context
+  void release(GLStateCache *state = nullptr)
+  {
+    for (auto &fence : m_Fences) {
+      if (fence) {
+        glDeleteSync(fence);
+        fence = nullptr;
+      }
+    }
+    if (m_Buffer) {
+      bindBuffer(state, m_Buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      bindBuffer(state, 0);
+      glDeleteBuffers(1, &m_Buffer);
+      m_Buffer = 0;
+      m_Mapped = nullptr;
+    }
+  }
+
+private:
+  static void bindBuffer(GLStateCache *state, GLuint buffer)
+  {
+    if (state) {
+      state->bindBuffer(GL_ARRAY_BUFFER, buffer);
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+  }
+
+  void allocate(GLsizeiptr segmentSize, GLStateCache *state)
+  {
+    // Draws still reading the old buffer keep it alive until they are done
+    release(state);
+    m_SegmentSize = segmentSize;
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &m_Buffer);
+    bindBuffer(state, m_Buffer);
+    glBufferStorage(
+        GL_ARRAY_BUFFER, segmentCount * m_SegmentSize, nullptr, flags);
+    m_Mapped = static_cast<char *>(glMapBufferRange(
+        GL_ARRAY_BUFFER, 0, segmentCount * m_SegmentSize, flags));
+    bindBuffer(state, 0);
+    m_Segment = 0;
+    m_Cursor = 0;
+  }
+
+  // Fences the draws issued from the current segment, then waits for the GPU
+  // to be done with the next one (usually long done, it was filled
+  // segmentCount - 1 segments ago)
+  void nextSegment()
+  {
+    m_Fences[m_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Segment = (m_Segment + 1) % segmentCount;
+    m_Cursor = 0;
+    auto &fence = m_Fences[m_Segment];
+    if (fence) {
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) ==
+             GL_TIMEOUT_EXPIRED) {
+      }
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  GLsizeiptr m_SegmentSize;
+  GLuint m_Buffer = 0;
+  char *m_Mapped = nullptr;
+  int m_Segment = 0;
+  GLintptr m_Cursor = 0; // Write position in the current segment
+  std::array<GLsync, segmentCount> m_Fences{};
+};
@@ -0,0 +1,201 @@
+#include "tangents.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <tiny_gltf.h>
+#include <vector>
+
+#include <xmmintrin.h>
+
+namespace
+{
+glm::vec3 readVec3(const StridedData &data, uint32_t i)
+{
+  glm::vec3 value;
+  std::memcpy(&value, data.data + i * data.stride, sizeof(value));
+  return value;
+}
+
+glm::vec2 readTexCoord(const StridedData &data, uint32_t type, uint32_t i)
+{
+  const auto element = data.data + i * data.stride;
+  if (type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+    return glm::vec2(element[0], element[1]) / 255.f;
+  }
+  if (type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+    uint16_t value[2];
+    std::memcpy(value, element, sizeof(value));
+    return glm::vec2(value[0], value[1]) / 65535.f;
+  }
+  glm::vec2 value;
+  std::memcpy(&value, element, sizeof(value));
+  return value;
+}
+
+uint32_t readIndex(const TangentInput &input, uint32_t i)
+{
+  if (!input.indices.data) {
+    return i;
+  }
+  const auto element = input.indices.data + i * input.indices.stride;
+  if (input.indexType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+    return element[0];
+  }
+  if (input.indexType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+    uint16_t index;
+    std::memcpy(&index, element, sizeof(index));
+    return index;
+  }
+  uint32_t index;
+  std::memcpy(&index, element, sizeof(index));
+  return index;
+}
+
+// Any unit vector orthogonal to n, for vertices without a usable tangent
+glm::vec3 getOrthogonal(const glm::vec3 &n)
+{
+  const auto axis = std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0)
+                                         : glm::vec3(0, 1, 0);
+  const auto t = glm::cross(axis, n);
+  const auto length = glm::length(t);
+  return length > 0.f ? t / length : axis;
+}
+
+// 4 triangles in structure of arrays, lane k holds triangle k.
+// computeFaceTangents fills the unnormalized tangent (the direction of
+// increasing u) and the orientation, -1 where the mapping is mirrored.
+struct FaceBatch
+{
+  alignas(16) float e1[3][4], e2[3][4]; // Edges from the first corner
+  alignas(16) float duv1[2][4], duv2[2][4];
+  alignas(16) float tangent[3][4];
+  alignas(16) float orientation[4]; // 1 or -1
+};
+
+void computeFaceTangents(FaceBatch &batch)
+{
+  const auto du1 = _mm_load_ps(batch.duv1[0]);
+  const auto dv1 = _mm_load_ps(batch.duv1[1]);
+  const auto du2 = _mm_load_ps(batch.duv2[0]);
+  const auto dv2 = _mm_load_ps(batch.duv2[1]);
+  const auto det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+  // Only the sign of the determinant matters, the magnitude is dropped by
+  // the normalization of the projected tangent
+  const auto negative = _mm_cmplt_ps(det, _mm_setzero_ps());
+  const auto one = _mm_set1_ps(1.f);
+  const auto sign = _mm_or_ps(_mm_and_ps(negative, _mm_set1_ps(-1.f)),
+      _mm_andnot_ps(negative, one));
+  _mm_store_ps(batch.orientation, sign);
+  for (int c = 0; c < 3; ++c) {
+    const auto t = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(batch.e1[c]), dv2),
+        _mm_mul_ps(_mm_load_ps(batch.e2[c]), dv1));
+    _mm_store_ps(batch.tangent[c], _mm_mul_ps(t, sign));
+  }
+}
+
+// Angle of the corner between edges a and b, projected on the plane of n
+float getCornerAngle(const glm::vec3 &n, glm::vec3 a, glm::vec3 b)
+{
+  a -= n * glm::dot(n, a);
+  b -= n * glm::dot(n, b);
+  const auto lengths = glm::length(a) * glm::length(b);
+  if (lengths <= 0.f) {
+    return 0.f;
+  }
+  return std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.f, 1.f));
+}
+} // namespace
+
+void generateTangents(const TangentInput &input, glm::vec4 *tangents)
+{
+  // Tangent sums in xyz, handedness sum in w, added with SSE
+  std::vector<glm::vec4> sums(input.vertexCount, glm::vec4(0.f));
+  const auto cornerCount =
+      input.indices.data ? input.indexCount : input.vertexCount;
+  const auto triangleCount = cornerCount / 3;
+
+  FaceBatch batch;
+  uint32_t corners[4][3];
+  const auto accumulate = [&](uint32_t laneCount) {
+    computeFaceTangents(batch);
+    for (uint32_t k = 0; k < laneCount; ++k) {
+      const glm::vec3 faceTangent(
+          batch.tangent[0][k], batch.tangent[1][k], batch.tangent[2][k]);
+      for (int c = 0; c < 3; ++c) {
+        const auto vertex = corners[k][c];
+        const auto n = readVec3(input.normals, vertex);
+        auto t = faceTangent - n * glm::dot(n, faceTangent);
+        const auto length = glm::length(t);
+        if (!(length > 0.f)) {
+          continue; // Degenerate mapping
+        }
+        const auto p = readVec3(input.positions, vertex);
+        const auto angle = getCornerAngle(n,
+            readVec3(input.positions, corners[k][(c + 1) % 3]) - p,
+            readVec3(input.positions, corners[k][(c + 2) % 3]) - p);
+        t *= angle / length;
+        const auto sum = &sums[vertex].x;
+        _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum),
+                               _mm_setr_ps(t.x, t.y, t.z,
+                                   angle * batch.orientation[k])));
+      }
+    }
+  };
+
+  uint32_t lane = 0;
+  for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+    auto &triangleCorners = corners[lane];
+    for (uint32_t c = 0; c < 3; ++c) {
+      triangleCorners[c] = readIndex(input, 3 * triangle + c);
+    }
+    if (std::max({triangleCorners[0], triangleCorners[1],
+            triangleCorners[2]}) >= input.vertexCount) {
+      continue; // Invalid index
+    }
+    const auto p0 = readVec3(input.positions, triangleCorners[0]);
+    const auto e1 = readVec3(input.positions, triangleCorners[1]) - p0;
+    const auto e2 = readVec3(input.positions, triangleCorners[2]) - p0;
+    const auto uv0 =
+        readTexCoord(input.texCoords, input.texCoordType, triangleCorners[0]);
+    const auto duv1 = readTexCoord(input.texCoords, input.texCoordType,
+                          triangleCorners[1]) -
+                      uv0;
+    const auto duv2 = readTexCoord(input.texCoords, input.texCoordType,
+                          triangleCorners[2]) -
+                      uv0;
+    for (int c = 0; c < 3; ++c) {
+      batch.e1[c][lane] = e1[c];
+      batch.e2[c][lane] = e2[c];
+    }
+    for (int c = 0; c < 2; ++c) {
+      batch.duv1[c][lane] = duv1[c];
+      batch.duv2[c][lane] = duv2[c];
+    }
+    if (++lane == 4) {
+      accumulate(4);
+      lane = 0;
+    }
+  }
+  if (lane) {
+    // Unused lanes are computed but not accumulated
+    for (auto k = lane; k < 4; ++k) {
+      for (int c = 0; c < 3; ++c) {
+        batch.e1[c][k] = batch.e2[c][k] = 0.f;
+      }
+      for (int c = 0; c < 2; ++c) {
+        batch.duv1[c][k] = batch.duv2[c][k] = 0.f;
+      }
+    }
+    accumulate(lane);
+  }
+
+  for (uint32_t i = 0; i < input.vertexCount; ++i) {
+    const auto n = readVec3(input.normals, i);
+    auto t = glm::vec3(sums[i]);
+    t -= n * glm::dot(n, t);
+    const auto length = glm::length(t);
+    t = length > 1e-20f ? t / length : getOrthogonal(n);
+    tangents[i] = glm::vec4(t, sums[i].w < 0.f ? -1.f : 1.f);
+  }
+}
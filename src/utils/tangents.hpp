@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Vertex data of a glTF accessor, element i is at data + i * stride
+struct StridedData
+{
+  const unsigned char *data;
+  size_t stride;
+};
+
+// Triangle list of a glTF primitive. Positions and normals are float VEC3,
+// texture coordinates are VEC2 of texCoordType (float, or normalized
+// unsigned byte or short), indices are of indexType (unsigned byte, short or
+// int) or absent if indices.data is null.
+struct TangentInput
+{
+  StridedData positions, normals, texCoords, indices;
+  uint32_t texCoordType;
+  uint32_t indexType;
+  uint32_t vertexCount;
+  uint32_t indexCount; // Ignored if not indexed
+};
+
+// Writes vertexCount tangents in the glTF convention: xyz orthogonal to the
+// normal, w the handedness (bitangent = cross(normal, xyz) * w). Follows
+// MikkTSpace: face tangents are projected on the plane of each vertex normal
+// and weighted by the angle of the corner, the handedness is the sign of the
+// UV mapping. Vertices are not split, so a vertex shared by faces of
+// opposite handedness gets the dominant one.
+void generateTangents(const TangentInput &input, glm::vec4 *tangents);
@@ -0,0 +1,173 @@
+#include "textureCache.hpp"
+#include "blockCompression.hpp"
+#include "glExtensions.hpp"
+#include "hash.hpp"
+#include "mappedFile.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+namespace
+{
+struct TextureCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  int32_t width, height;
+  uint32_t levelCount;
+  PixelFormat format;
+  uint64_t size, padding; // Pixels follow the header
+};
+
+const char textureCacheMagic[4] = {'P', 'G', 'T', 'X'};
+
+fs::path getTextureCachePath(const fs::path &cacheDirectory, uint64_t key)
+{
+  return cacheDirectory / (toHexString(key) + ".pgtex");
+}
+
+bool readTextureCache(const MappedFile &file, uint64_t key, ImageMips &mips)
+{
+  TextureCacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, textureCacheMagic, sizeof(header.magic)) ||
+      header.version != textureCacheVersion || header.key != key ||
+      header.width <= 0 || header.height <= 0 ||
+      header.format > PixelFormat::Bc7 ||
+      header.size != file.size() - sizeof(header) ||
+      header.levelCount != getMipLevelCount(header.width, header.height) ||
+      header.size != getMipLevelOffset(header.width, header.height,
+                         header.levelCount, header.format)) {
+    return false;
+  }
+  mips = {header.width, header.height, header.levelCount, header.format,
+      file.data() + sizeof(header), header.size};
+  return true;
+}
+
+// Through a temporary file renamed once complete, like writeSceneCache. The
+// same image may be written by several threads at once, so each one has its
+// own.
+void writeTextureCache(
+    const fs::path &path, uint64_t key, const ImageMips &mips)
+{
+  std::error_code error;
+  fs::create_directories(path.parent_path(), error);
+  auto tmpPath = path;
+  const auto thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  tmpPath += "." + toHexString(thread) + ".tmp";
+  std::ofstream out{tmpPath, std::ios::binary | std::ios::trunc};
+  TextureCacheHeader header{};
+  std::memcpy(header.magic, textureCacheMagic, sizeof(header.magic));
+  header.version = textureCacheVersion;
+  header.key = key;
+  header.width = mips.width;
+  header.height = mips.height;
+  header.levelCount = mips.levelCount;
+  header.format = mips.format;
+  header.size = mips.size;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(mips.pixels),
+      std::streamsize(mips.size));
+  out.close();
+  if (!out) {
+    std::cerr << "Unable to write texture cache " << tmpPath << std::endl;
+    fs::remove(tmpPath, error);
+    return;
+  }
+  fs::rename(tmpPath, path, error);
+  if (error) {
+    fs::remove(tmpPath, error);
+  }
+}
+} // namespace
+
+TextureFormats getCompressedTextureFormats()
+{
+  static const auto s3tc =
+      isExtensionSupported("GL_EXT_texture_compression_s3tc");
+  return {s3tc ? PixelFormat::Bc1 : PixelFormat::Bc7, PixelFormat::Bc7};
+}
+
+uint64_t getTextureCacheKey(
+    const unsigned char *encoded, size_t size, const TextureFormats &formats)
+{
+  const auto key = hashBytes(encoded, size);
+  return hashBytes(&formats, sizeof(formats), key);
+}
+
+ImageMips decodeTexture(const unsigned char *encoded, size_t size,
+    const TextureFormats &formats, const fs::path &cacheDirectory,
+    std::shared_ptr<const void> &owner)
+{
+  return decodeTexture(encoded, size, formats,
+      getTextureCacheKey(encoded, size, formats), cacheDirectory, owner);
+}
+
+ImageMips decodeTexture(const unsigned char *encoded, size_t size,
+    const TextureFormats &formats, uint64_t key,
+    const fs::path &cacheDirectory, std::shared_ptr<const void> &owner)
+{
+  fs::path cachePath;
+  if (!cacheDirectory.empty()) {
+    auto mips = mapTexture(cacheDirectory, key, owner);
+    if (mips.pixels) {
+      return mips;
+    }
+    cachePath = getTextureCachePath(cacheDirectory, key);
+  }
+
+  ImageMips mips;
+
+  int components = 0;
+  const auto data = size ? stbi_load_from_memory(encoded, int(size),
+                               &mips.width, &mips.height, &components,
+                               STBI_rgb_alpha)
+                         : nullptr;
+  if (!data) {
+    return ImageMips{};
+  }
+  auto pixels = std::make_shared<std::vector<unsigned char>>(
+      data, data + size_t(mips.width) * mips.height * 4);
+  stbi_image_free(data);
+  mips.format = hasTransparentPixels(pixels->data(),
+                    size_t(mips.width) * mips.height)
+                    ? formats.transparent
+                    : formats.opaque;
+  generateMipChain(mips.width, mips.height, *pixels);
+  if (mips.format != PixelFormat::Rgba8) {
+    *pixels = compressMipChain(mips.width, mips.height, *pixels, mips.format);
+  }
+  mips.levelCount = getMipLevelCount(mips.width, mips.height);
+  mips.pixels = pixels->data();
+  mips.size = pixels->size();
+  if (!cachePath.empty()) {
+    writeTextureCache(cachePath, key, mips);
+  }
+  owner = std::move(pixels);
+  return mips;
+}
+
+ImageMips mapTexture(const fs::path &cacheDirectory, uint64_t key,
+    std::shared_ptr<const void> &owner)
+{
+  ImageMips mips;
+  auto file = std::make_shared<MappedFile>();
+  if (file->open(getTextureCachePath(cacheDirectory, key)) &&
+      readTextureCache(*file, key, mips)) {
+    owner = std::move(file);
+    return mips;
+  }
+  return ImageMips{};
+}
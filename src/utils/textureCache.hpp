@@ -0,0 +1,52 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "images.hpp"
+
+#include <cstddef>
+#include <memory>
+
+// Formats decodeTexture stores images in, depending on whether they have
+// transparent pixels
+struct TextureFormats
+{
+  PixelFormat opaque = PixelFormat::Rgba8;
+  PixelFormat transparent = PixelFormat::Rgba8;
+};
+
+// Block formats of the current GL context: BC7 is core since GL 4.2, BC1
+// halves it for opaque images when EXT_texture_compression_s3tc is there
+TextureFormats getCompressedTextureFormats();
+
+// Decoded textures, stored as is in files named after the hash of the encoded
+// image and of the formats: an image is decoded, filtered and compressed
+// once, whatever the file it comes from.
+constexpr uint32_t textureCacheVersion = 3;
+
+// Where the textures of a scene cache directory are, empty if it is
+inline fs::path getTextureCacheDirectory(const fs::path &cacheDirectory)
+{
+  return cacheDirectory.empty() ? fs::path{} : cacheDirectory / "textures";
+}
+
+// Names the cache file of an encoded image decoded to one of formats
+uint64_t getTextureCacheKey(
+    const unsigned char *encoded, size_t size, const TextureFormats &formats);
+
+// Decodes an encoded image (PNG, JPEG...) to its full mip chain in one of
+// formats, or maps it from cacheDirectory (if not empty) when it already was.
+// owner holds the pixels of the result, which is empty if the image can't be
+// decoded. Safe to call from several threads at once.
+ImageMips decodeTexture(const unsigned char *encoded, size_t size,
+    const TextureFormats &formats, const fs::path &cacheDirectory,
+    std::shared_ptr<const void> &owner);
+
+// Same, with the getTextureCacheKey of the image already known
+ImageMips decodeTexture(const unsigned char *encoded, size_t size,
+    const TextureFormats &formats, uint64_t key,
+    const fs::path &cacheDirectory, std::shared_ptr<const void> &owner);
+
+// Maps the image decodeTexture cached under key in cacheDirectory, empty if
+// there is no valid file for it
+ImageMips mapTexture(const fs::path &cacheDirectory, uint64_t key,
+    std::shared_ptr<const void> &owner);
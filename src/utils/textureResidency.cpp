@@ -0,0 +1,169 @@
+#include "textureResidency.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void TextureResidency::reset(
+    const SceneData &scene, const std::vector<GLuint> &textures)
+{
+  m_Entries.assign(textures.size(), Entry{});
+  m_Images.assign(scene.imageCount, nullptr);
+  m_ImageTextures.assign(scene.imageCount, {});
+  for (size_t i = 0; i < textures.size(); ++i) {
+    auto &entry = m_Entries[i];
+    entry.texture = textures[i];
+    entry.image = scene.textures[i].image;
+    if (entry.image >= 0) {
+      m_ImageTextures[entry.image].push_back(uint32_t(i));
+    }
+  }
+  m_ResidentSize = 0;
+  m_ReleasedLevelCount = 0;
+}
+
+void TextureResidency::addImage(std::shared_ptr<const DecodedImage> image)
+{
+  if (image->image < 0 || size_t(image->image) >= m_Images.size()) {
+    return;
+  }
+  const auto &mips = image->mips;
+  m_Images[image->image] = image;
+  if (!mips.levelCount) {
+    return; // Not decoded, its textures stay white
+  }
+  for (const auto texture : m_ImageTextures[image->image]) {
+    auto &entry = m_Entries[texture];
+    entry.levelCount = mips.levelCount;
+    entry.baseLevel = mips.levelCount;
+    entry.minLevel = mips.levelCount - 1;
+    while (entry.minLevel > 0 &&
+           getLevelSize(entry, entry.minLevel - 1) <= minResidentSize) {
+      --entry.minLevel;
+    }
+    entry.wantedLevel = entry.requestedLevel = entry.minLevel;
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levelCount - 1);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureResidency::request(int32_t texture, float screenSize)
+{
+  if (texture < 0) {
+    return;
+  }
+  auto &entry = m_Entries[texture];
+  entry.lastUse = m_Frame;
+  if (!entry.levelCount) {
+    return;
+  }
+  const auto &mips = m_Images[entry.image]->mips;
+  const auto size = float(std::max(mips.width, mips.height));
+  const auto level =
+      screenSize < size
+          ? uint32_t(std::log2(size / std::max(screenSize, 1.f)))
+          : 0u;
+  entry.requestedLevel = std::min(entry.requestedLevel, level);
+}
+
+size_t TextureResidency::update(size_t uploadBudget, StreamBuffer &staging)
+{
+  // Textures that weren't drawn only want their smallest levels
+  std::vector<Entry *> queue;
+  for (auto &entry : m_Entries) {
+    if (!entry.levelCount) {
+      continue;
+    }
+    entry.wantedLevel =
+        entry.lastUse == m_Frame ? entry.requestedLevel : entry.minLevel;
+    entry.requestedLevel = entry.minLevel;
+    if (entry.baseLevel > entry.wantedLevel) {
+      queue.push_back(&entry);
+    }
+  }
+  makeRoom(0, nullptr); // In case the budget went down
+
+  // Drawn textures first, the ones missing the most levels first
+  std::sort(begin(queue), end(queue), [](const Entry *a, const Entry *b) {
+    if (a->lastUse != b->lastUse) {
+      return a->lastUse > b->lastUse;
+    }
+    return a->baseLevel - a->wantedLevel > b->baseLevel - b->wantedLevel;
+  });
+  size_t spent = 0;
+  for (const auto entry : queue) {
+    while (entry->baseLevel > entry->wantedLevel && spent < uploadBudget) {
+      const auto size = getLevelSize(*entry, entry->baseLevel - 1);
+      if (!makeRoom(size, entry)) {
+        break;
+      }
+      uploadLevel(*entry, staging);
+      spent += size;
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  ++m_Frame;
+  return spent;
+}
+
+uint64_t TextureResidency::getLevelSize(
+    const Entry &entry, uint32_t level) const
+{
+  const auto &mips = m_Images[entry.image]->mips;
+  return getMipLevelRows(mips.height, level, mips.format) *
+         getMipLevelRowSize(mips.width, level, mips.format);
+}
+
+void TextureResidency::uploadLevel(Entry &entry, StreamBuffer &staging)
+{
+  const auto level = entry.baseLevel - 1;
+  const auto &mips = m_Images[entry.image]->mips;
+  const auto size = getLevelSize(entry, level);
+  const auto pixels =
+      mips.pixels +
+      getMipLevelOffset(mips.width, mips.height, level, mips.format);
+  glBindTexture(GL_TEXTURE_2D, entry.texture);
+  // Through the staging ring, unless the level doesn't fit in a segment and
+  // the driver copies it instead
+  if (size <= uint64_t(staging.getSegmentSize())) {
+    const auto offset = staging.upload(pixels, GLsizeiptr(size), 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.getBuffer());
+    specifyMipLevel(GL_TEXTURE_2D, mips, level, (const GLvoid *)offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  } else {
+    specifyMipLevel(GL_TEXTURE_2D, mips, level, pixels);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  entry.baseLevel = level;
+  m_ResidentSize += size;
+}
+
+void TextureResidency::releaseLevel(Entry &entry)
+{
+  const auto level = entry.baseLevel++;
+  glBindTexture(GL_TEXTURE_2D, entry.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.baseLevel);
+  releaseMipLevel(GL_TEXTURE_2D, m_Images[entry.image]->mips, level);
+  m_ResidentSize -= getLevelSize(entry, level);
+  ++m_ReleasedLevelCount;
+}
+
+bool TextureResidency::makeRoom(uint64_t size, const Entry *except)
+{
+  while (m_ResidentSize + size > m_Budget) {
+    // Levels finer than wanted, of the least recently drawn texture. The
+    // levels up to minLevel are always wanted.
+    Entry *victim = nullptr;
+    for (auto &entry : m_Entries) {
+      if (&entry != except && entry.baseLevel < entry.wantedLevel &&
+          (!victim || entry.lastUse < victim->lastUse)) {
+        victim = &entry;
+      }
+    }
+    if (!victim) {
+      return false;
+    }
+    releaseLevel(*victim);
+  }
+  return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "images.hpp"
+#include "sceneData.hpp"
+#include "streamBuffer.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Mip chain of the image of index image in the glTF model
+struct DecodedImage
+{
+  int32_t image;
+  ImageMips mips;
+  std::shared_ptr<const void> owner; // Of mips.pixels
+};
+
+// Keeps in video memory the mip levels of the scene textures that the view
+// needs, under a budget. Draws report how large their textures appear on
+// screen (see request), textures get their levels from the coarsest to the
+// finest one needed, and the finest levels of the least recently drawn
+// textures are released when the budget is exceeded. Resident levels are
+// [GL_TEXTURE_BASE_LEVEL, levelCount), so the textures are mutable: released
+// levels are respecified empty. Decoded images are kept to upload their
+// levels again when they are needed again.
+class TextureResidency
+{
+public:
+  // Levels up to this size are never released once uploaded, so that a
+  // texture never goes back to white
+  static constexpr uint64_t minResidentSize = 16 * 1024;
+
+  // One entry per SceneData::textures, in textures
+  void reset(const SceneData &scene, const std::vector<GLuint> &textures);
+
+  // Levels of the textures of image can be uploaded from now on
+  void addImage(std::shared_ptr<const DecodedImage> image);
+
+  // texture is drawn this frame, its largest side covering screenSize pixels
+  // (one texel per pixel is enough)
+  void request(int32_t texture, float screenSize);
+
+  // Releases levels until the resident size fits the budget, then uploads
+  // at most uploadBudget bytes of the levels requested since the last call.
+  // Returns the bytes uploaded. Binds textures and GL_PIXEL_UNPACK_BUFFER
+  // directly, so it is only called between frames (see GLStateCache).
+  size_t update(size_t uploadBudget, StreamBuffer &staging);
+
+  // At least one level is resident
+  bool isReady(int32_t texture) const
+  {
+    return texture >= 0 &&
+           m_Entries[texture].baseLevel < m_Entries[texture].levelCount;
+  }
+
+  void setBudget(uint64_t budget) { m_Budget = budget; }
+  uint64_t getBudget() const { return m_Budget; }
+  uint64_t getResidentSize() const { return m_ResidentSize; }
+  uint32_t getReleasedLevelCount() const { return m_ReleasedLevelCount; }
+
+private:
+  struct Entry
+  {
+    GLuint texture = 0;
+    int32_t image = -1;
+    uint32_t levelCount = 0;     // 0 until the image is decoded
+    uint32_t baseLevel = 0;      // First resident level, levelCount if none
+    uint32_t minLevel = 0;       // Finest level up to minResidentSize
+    uint32_t wantedLevel = 0;    // Finest level needed by the last frame
+    uint32_t requestedLevel = 0; // Finest level requested in this frame
+    uint64_t lastUse = 0;        // Frame of the last request
+  };
+
+  uint64_t getLevelSize(const Entry &entry, uint32_t level) const;
+  void uploadLevel(Entry &entry, StreamBuffer &staging);
+  void releaseLevel(Entry &entry);
+  // Releases levels of textures other than except until size more bytes fit
+  // in the budget. Returns false if only needed levels are left.
+  bool makeRoom(uint64_t size, const Entry *except);
+
+  std::vector<Entry> m_Entries;
+  std::vector<std::shared_ptr<const DecodedImage>> m_Images; // Per image
+  std::vector<std::vector<uint32_t>> m_ImageTextures;         // Per image
+  uint64_t m_Frame = 1;
+  uint64_t m_Budget = 256 * 1024 * 1024;
+  uint64_t m_ResidentSize = 0;
+  uint32_t m_ReleasedLevelCount = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks, shared by the loading
+// code (glTF parsing, image decoding...). Queued tasks still run when the
+// pool is destroyed.
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t threadCount = getDefaultThreadCount())
+  {
+    for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+      m_Workers.emplace_back([this]() { work(); });
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for (auto &worker : m_Workers) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Leaves a core to the GL thread
+  static size_t getDefaultThreadCount()
+  {
+    const auto cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+  }
+
+  size_t size() const { return m_Workers.size(); }
+
+  template <typename Task> auto submit(Task &&task)
+  {
+    using Result = decltype(task());
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Task>(task));
+    auto future = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      m_Tasks.emplace_back([packaged]() { (*packaged)(); });
+    }
+    m_Condition.notify_one();
+    return future;
+  }
+
+  // Calls body(i) for every i in [0, count), on the workers and on the
+  // calling thread, and returns once every call is done. The calling thread
+  // takes part so that this can be used from a task of the pool itself.
+  template <typename Body> void parallelFor(size_t count, Body &&body)
+  {
+    if (count == 0) {
+      return;
+    }
+    struct State
+    {
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> done{0};
+      std::mutex mutex;
+      std::condition_variable finished;
+    };
+    // Helpers may start after the loop is over, so they share the state
+    const auto state = std::make_shared<State>();
+    const auto run = [state, count, &body]() {
+      for (auto i = state->next++; i < count; i = state->next++) {
+        body(i);
+        if (++state->done == count) {
+          std::lock_guard<std::mutex> lock{state->mutex};
+          state->finished.notify_all();
+        }
+      }
+    };
+    const auto helperCount = std::min(count - 1, size());
+    {
+      std::lock_guard<std::mutex> lock{m_Mutex};
+      for (size_t i = 0; i < helperCount; ++i) {
+        m_Tasks.emplace_back(run);
+      }
+    }
+    m_Condition.notify_all();
+    run();
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->finished.wait(lock, [&]() { return state->done == count; });
+  }
+
+private:
+  void work()
+  {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock{m_Mutex};
+        m_Condition.wait(
+            lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+        if (m_Tasks.empty()) {
+          return; // Stopping
+        }
+        task = std::move(m_Tasks.front());
+        m_Tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  bool m_Stopping = false;
+};
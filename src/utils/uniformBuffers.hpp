@@ -0,0 +1,152 @@
+#pragma once
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Binding points of the uniform blocks, see UniformHandler
+enum UniformBlockBinding : GLuint
+{
+  FrameBlockBinding = 0,
+  ObjectBlockBinding = 1
+};
+
+// std140 layout of the FrameUniforms block of the shaders, keep both in sync
+struct FrameUniforms
+{
+  glm::mat4 viewMatrix;
+  glm::mat4 projMatrix;
+  glm::mat4 viewProjMatrix;
+  glm::mat4 skyViewProjMatrix; // Without the translation of the camera
+  glm::vec4 lightDirection;    // View space
+  glm::vec4 lightIntensity;
+};
+
+// std140 layout of the ObjectUniforms block of the shaders
+struct ObjectUniforms
+{
+  glm::mat4 modelMatrix;
+  glm::mat4 normalMatrix; // transpose(inverse(modelMatrix))
+};
+
+static_assert(sizeof(FrameUniforms) == 4 * 64 + 2 * 16, "std140 mismatch");
+static_assert(sizeof(ObjectUniforms) == 2 * 64, "std140 mismatch");
+
+// Matrices shared by every draw of a frame, uploaded once per frame and bound
+// to FrameBlockBinding for every program
+class FrameUniformBuffer
+{
+public:
+  FrameUniformBuffer()
+  {
+    glGenBuffers(1, &m_Buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+    glBufferData(
+        GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameBlockBinding, m_Buffer);
+  }
+
+  void update(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+      const glm::vec3 &lightDirection, const glm::vec3 &lightIntensity)
+  {
+    const FrameUniforms frame{viewMatrix, projMatrix, projMatrix * viewMatrix,
+        projMatrix * glm::mat4(glm::mat3(viewMatrix)),
+        glm::vec4(glm::normalize(glm::mat3(viewMatrix) * lightDirection), 0.f),
+        glm::vec4(lightIntensity, 0.f)};
+    glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+
+private:
+  GLuint m_Buffer = 0;
+};
+
+// Model matrices of every object, one slot per object. Slots are written on
+// the CPU when an object is added or moved, and only the changed range is
+// uploaded, so static objects are uploaded once. A draw binds its slot to
+// ObjectBlockBinding with glBindBufferRange.
+class ObjectUniformBuffer
+{
+public:
+  static constexpr uint32_t identitySlot = 0; // For objects in world space
+
+  ObjectUniformBuffer()
+  {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_Stride = (sizeof(ObjectUniforms) + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &m_Buffer);
+    add(glm::mat4(1.f));
+  }
+
+  // Returns the slot of a new object, reusing the slots of removed ones
+  uint32_t add(const glm::mat4 &modelMatrix)
+  {
+    uint32_t slot;
+    if (!m_FreeSlots.empty()) {
+      slot = m_FreeSlots.back();
+      m_FreeSlots.pop_back();
+    } else {
+      slot = uint32_t(m_Data.size() / m_Stride);
+      m_Data.resize(m_Data.size() + m_Stride);
+    }
+    set(slot, modelMatrix);
+    return slot;
+  }
+
+  // The slot is left as is until it is reused
+  void remove(uint32_t slot) { m_FreeSlots.push_back(slot); }
+
+  void set(uint32_t slot, const glm::mat4 &modelMatrix)
+  {
+    const ObjectUniforms object{
+        modelMatrix, glm::transpose(glm::inverse(modelMatrix))};
+    std::memcpy(m_Data.data() + slot * m_Stride, &object, sizeof(object));
+    m_DirtyBegin = std::min(m_DirtyBegin, slot);
+    m_DirtyEnd = std::max(m_DirtyEnd, slot + 1);
+  }
+
+  uint32_t size() const { return uint32_t(m_Data.size() / m_Stride); }
+
+  // Uploads the slots changed since the last upload
+  void upload()
+  {
+    if (m_DirtyBegin >= m_DirtyEnd) {
+      return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+    if (m_Capacity < m_Data.size()) {
+      m_Capacity = 2 * m_Data.size();
+      glBufferData(GL_UNIFORM_BUFFER, m_Capacity, nullptr, GL_DYNAMIC_DRAW);
+      m_DirtyBegin = 0;
+      m_DirtyEnd = size();
+    }
+    glBufferSubData(GL_UNIFORM_BUFFER, m_DirtyBegin * m_Stride,
+        (m_DirtyEnd - m_DirtyBegin) * m_Stride,
+        m_Data.data() + m_DirtyBegin * m_Stride);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_DirtyBegin = UINT32_MAX;
+    m_DirtyEnd = 0;
+  }
+
+  void bind(uint32_t slot)
+  {
+    upload();
+    glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, m_Buffer,
+        slot * m_Stride, sizeof(ObjectUniforms));
+  }
+
+private:
+  GLuint m_Buffer = 0;
+  size_t m_Stride;
+  size_t m_Capacity = 0; // In bytes
+  std::vector<unsigned char> m_Data;
+  std::vector<uint32_t> m_FreeSlots;
+  uint32_t m_DirtyBegin = UINT32_MAX, m_DirtyEnd = 0;
+};
@@ -1,23 +1,32 @@
 #pragma once
 
 #include "shaders.hpp"
+#include "uniformBuffers.hpp"
 
+// Connects the uniform blocks of a program to the shared uniform buffers
 class UniformHandler
 {
 public:
-  UniformHandler(const GLProgram &program) : _program{program} { getUniform(); }
-
-  GLuint uModelViewProjMatrix, uModelViewMatrix, uNormalMatrix;
+  UniformHandler(const GLProgram &program) : _program{program}
+  {
+    bindBlocks();
+  }
 
 private:
-  void getUniform()
+  void bindBlocks()
+  {
+    bindBlock("FrameUniforms", FrameBlockBinding);
+    bindBlock("ObjectUniforms", ObjectBlockBinding);
+  }
+
+  // Blocks unused by the program are optimized out and skipped
+  void bindBlock(const GLchar *name, GLuint binding)
   {
-    uModelViewProjMatrix =
-        glGetUniformLocation(_program.glId(), "uModelViewProjMatrix");
-    uModelViewMatrix =
-        glGetUniformLocation(_program.glId(), "uModelViewMatrix");
-    uNormalMatrix = glGetUniformLocation(_program.glId(), "uNormalMatrix");
+    const auto index = glGetUniformBlockIndex(_program.glId(), name);
+    if (index != GL_INVALID_INDEX) {
+      glUniformBlockBinding(_program.glId(), index, binding);
+    }
   }
 
   const GLProgram &_program;
-};
\ No newline at end of file
+};